@@ -172,17 +172,13 @@ public:
         m_codeSize = 0;
     }
 
-    int InternalEncode(char* fileName, uint8_t* header, int headerSize, uint8_t* buffer, int bufferSize)
+    // encodes the buffer into the opened file at its current position, returns the number of bytes written
+    int EncodeStream(const File& fp, const uint8_t* buffer, int bufferSize)
     {
         int i, length, node, strPtr, lastMatchLength, codeBufferPtr, bufferPtr = 0;
         uint8_t codeBuffer[17], mask, bit;
 
-        File fp(fileName, "wb");
-
-        if (!fp.IsValid())
-            return -1;
-
-        fp.Write(header, headerSize, 1);
+        m_codeSize = 0;
         InitTree();
 
         codeBuffer[0] = 0;
@@ -200,7 +196,7 @@ public:
         }
 
         if ((m_textSize = length) == 0)
-            return -1;
+            return 0;
 
         for (i = 1; i <= F; i++)
             InsertNode(node - i);
@@ -225,8 +221,8 @@ public:
 
             if ((mask <<= 1) == 0)
             {
-                for (i = 0; i < codeBufferPtr; i++)
-                    fp.PutCharacter(codeBuffer[i]);
+                if (!fp.Write(codeBuffer, codeBufferPtr))
+                    return -1;
 
                 m_codeSize += codeBufferPtr;
                 codeBuffer[0] = 0;
@@ -263,17 +259,17 @@ public:
 
         if (codeBufferPtr > 1)
         {
-            for (i = 0; i < codeBufferPtr; i++)
-                fp.PutCharacter(codeBuffer[i]);
+            if (!fp.Write(codeBuffer, codeBufferPtr))
+                return -1;
 
             m_codeSize += codeBufferPtr;
         }
-        fp.Close();
 
         return m_codeSize;
     }
 
-    int InternalDecode(char* fileName, int headerSize, uint8_t* buffer, int bufferSize)
+    // decodes packedSize bytes from the opened file at its current position, returns the number of bytes decoded
+    int DecodeStream(const File& fp, int packedSize, uint8_t* buffer, int bufferSize)
     {
         int i, j, k, node;
         uint32_t flags;
@@ -281,49 +277,46 @@ public:
 
         uint8_t bit;
 
-        File fp(fileName, "rb");
-
-        if (!fp.IsValid())
-            return -1;
-
-        fp.Seek(headerSize, SEEK_SET);
-
         node = N - F;
         for (i = 0; i < node; i++)
             m_textBuffer[i] = ' ';
 
         flags = 0;
 
+        // the stream has no end marker, so stop when all packed bytes are used up
         for (;;)
         {
             if (((flags >>= 1) & 256) == 0)
             {
-                if ((bit = static_cast <uint8_t> (fp.GetCharacter())) == EOF)
+                if (packedSize-- <= 0)
                     break;
 
+                bit = fp.GetCharacter();
                 flags = bit | 0xff00;
             }
 
             if (flags & 1)
             {
-                if ((bit = static_cast <uint8_t> (fp.GetCharacter())) == EOF)
+                if (packedSize-- <= 0)
                     break;
 
-                buffer[bufferPtr++] = bit;
+                bit = fp.GetCharacter();
 
-                if (bufferPtr > bufferSize)
+                if (bufferPtr >= bufferSize)
                     return -1;
 
+                buffer[bufferPtr++] = bit;
+
                 m_textBuffer[node++] = bit;
                 node &= (N - 1);
             }
             else
             {
-                if ((i = fp.GetCharacter()) == EOF)
+                if ((packedSize -= 2) < 0)
                     break;
 
-                if ((j = fp.GetCharacter()) == EOF)
-                    break;
+                i = fp.GetCharacter();
+                j = fp.GetCharacter();
 
                 i |= ((j & 0xf0) << 4);
                 j = (j & 0x0f) + THRESHOLD;
@@ -331,20 +324,49 @@ public:
                 for (k = 0; k <= j; k++)
                 {
                     bit = m_textBuffer[(i + k) & (N - 1)];
-                    buffer[bufferPtr++] = bit;
 
-                    if (bufferPtr > bufferSize)
+                    if (bufferPtr >= bufferSize)
                         return -1;
 
+                    buffer[bufferPtr++] = bit;
+
                     m_textBuffer[node++] = bit;
                     node &= (N - 1);
                 }
             }
         }
 
+        return bufferPtr;
+    }
+
+    int InternalEncode(char* fileName, uint8_t* header, int headerSize, uint8_t* buffer, int bufferSize)
+    {
+        File fp(fileName, "wb");
+
+        if (!fp.IsValid())
+            return -1;
+
+        fp.Write(header, headerSize, 1);
+
+        int result = EncodeStream(fp, buffer, bufferSize);
         fp.Close();
 
-        return bufferPtr;
+        return result > 0 ? result : -1;
+    }
+
+    int InternalDecode(char* fileName, int headerSize, uint8_t* buffer, int bufferSize)
+    {
+        File fp(fileName, "rb");
+
+        if (!fp.IsValid())
+            return -1;
+
+        fp.Seek(headerSize, SEEK_SET);
+
+        int result = DecodeStream(fp, fp.GetSize() - headerSize, buffer, bufferSize);
+        fp.Close();
+
+        return result;
     }
 
     // external decoder
@@ -57,6 +57,11 @@ using namespace Math;
 #include <runtime.h>
 
 #include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
 
 using namespace std;
 
@@ -91,6 +96,13 @@ enum BotTask
 	TASK_GOINGFORCAMP
 };
 
+// job execution types
+enum JobType
+{
+	JOB_ENGINE, // runs on the engine thread, in submission order
+	JOB_PARALLEL // runs on any worker thread, must not touch the engine
+};
+
 // supported cs's
 enum GameVersion
 {
@@ -373,6 +385,14 @@ enum Visibility
 	VISIBILITY_OTHER = (1 << 3)
 };
 
+// waypoint visibility table rows used by the set queries
+enum VisibilityRow
+{
+	VISROW_STAND = (1 << 0),
+	VISROW_CROUCH = (1 << 1),
+	VISROW_ANY = VISROW_STAND | VISROW_CROUCH
+};
+
 // defines map type
 enum MapType
 {
@@ -449,8 +469,13 @@ enum GameMode
 const char FH_WAYPOINT_NEW[] = "EBOTWAY!";
 const char FH_WAYPOINT[] = "PODWAY!";
 const char FH_VISTABLE[] = "PODVIS!";
+const char FH_PATHMATRIX[] = "EBOTPMT";
+const char FH_EXPERIENCE[] = "EBOTEXP";
 
-const int FV_WAYPOINT = 7;
+const int FV_WAYPOINT = 8; // 7 and older store raw path structures
+const int FV_PATHMATRIX = 2;
+const int FV_VISTABLE = 1;
+const int FV_EXPERIENCE = 1;
 
 // some hardcoded desire defines used to override calculated ones
 const float TASKPRI_NORMAL = 35.0f;
@@ -479,7 +504,8 @@ const int Const_MaxDamageValue = 2040;
 const int Const_MaxGoalValue = 2040;
 const int Const_MaxKillHistory = 16;
 const int Const_MaxRegMessages = 256;
-const int Const_MaxWaypoints = 2048;
+const int Const_MaxWaypoints = 8192; // waypoint storage grows with the map, this only limits the path matrices
+const int Const_MaxMatrixWaypoints = 2048; // path matrices take 8 bytes per waypoint pair and cubic time to build, bigger maps use direct distances
 const int Const_MaxWeapons = 32;
 const int Const_NumWeapons = 26;
 
@@ -495,6 +521,31 @@ struct AStar_t
 	State state;
 };
 
+// A* cost and heuristic functions
+typedef const float (*PathCostFunc) (int index, int team, bool isZombie);
+typedef const float (*PathHeuristicFunc) (int start, int goal);
+
+// A* cost profiles
+enum PathCostProfile
+{
+	PATHCOST_HUMAN,
+	PATHCOST_CAREFUL,
+	PATHCOST_NORMAL,
+	PATHCOST_RUSHER,
+	PATHCOST_NOHOSTAGE,
+	PATHCOST_NUM
+};
+
+// A* search results
+enum SearchResult
+{
+	SEARCH_FAILED,
+	SEARCH_FOUND,
+	SEARCH_RUNNING // out of expansion budget, continued in next frame
+};
+
+class SearchWorkspace;
+
 // weapon masks
 const int WeaponBits_Primary = ((1 << WEAPON_XM1014) | (1 << WEAPON_M3) | (1 << WEAPON_MAC10) | (1 << WEAPON_UMP45) | (1 << WEAPON_MP5) | (1 << WEAPON_TMP) | (1 << WEAPON_P90) | (1 << WEAPON_AUG) | (1 << WEAPON_M4A1) | (1 << WEAPON_SG552) | (1 << WEAPON_AK47) | (1 << WEAPON_SCOUT) | (1 << WEAPON_SG550) | (1 << WEAPON_AWP) | (1 << WEAPON_G3SG1) | (1 << WEAPON_M249) | (1 << WEAPON_FAMAS) | (1 << WEAPON_GALIL));
 const int WeaponBits_Secondary = ((1 << WEAPON_P228) | (1 << WEAPON_ELITE) | (1 << WEAPON_USP) | (1 << WEAPON_GLOCK18) | (1 << WEAPON_DEAGLE) | (1 << WEAPON_FN57));
@@ -652,6 +703,52 @@ struct WaypointHeader
 	char author[32];
 };
 
+// sections of the packed waypoint file, visibility and matrix are the .vis and .pmt files as they are
+enum WaypointSection
+{
+	WPSECTION_NODES = 1,
+	WPSECTION_CONNECTIONS = 2,
+	WPSECTION_VISIBILITY = 3,
+	WPSECTION_MATRIX = 4
+};
+
+// packed waypoint file, it follows the waypoint header. every section is LZSS packed on its own
+struct WaypointPackHeader
+{
+	uint32_t graphHash; // hash of the waypoint links, checked again after loading
+	int32_t numSections;
+};
+
+struct WaypointSectionHeader
+{
+	int32_t type;
+	int32_t rawSize;
+	int32_t packedSize;
+	uint32_t dataHash; // hash of the unpacked data
+};
+
+// per waypoint record of the nodes section
+struct WaypointNodeRecord
+{
+	int32 flags;
+	Vector origin;
+	float radius;
+
+	float campStartX;
+	float campStartY;
+	float campEndX;
+	float campEndY;
+};
+
+// per waypoint record of the connections section
+struct WaypointLinkRecord
+{
+	int16 index[Const_MaxPathIndex];
+	uint16 connectionFlags[Const_MaxPathIndex];
+	Vector connectionVelocity[Const_MaxPathIndex];
+	int32 distances[Const_MaxPathIndex];
+};
+
 // general experience & vistable header information structure
 struct ExtensionHeader
 {
@@ -660,6 +757,37 @@ struct ExtensionHeader
 	int32 pointNumber;
 };
 
+// experience file header, LZSS packed experience data follows it
+struct ExperienceHeader
+{
+	char header[8];
+	int32_t fileVersion;
+	int32_t pointNumber;
+	uint32_t graphHash; // hash of the waypoint links the experience was collected on
+	int32_t rawSize;
+	uint32_t dataHash; // hash of the unpacked data
+};
+
+// path matrix header, 16-bit next hop and distance matrices follow it
+struct PathMatrixHeader
+{
+	char header[8];
+	int32_t fileVersion;
+	int32_t pointNumber;
+	uint32_t graphHash; // hash of the waypoint links the matrix was built from
+	int32_t distanceShift; // stored distances are shifted right by this to fit into 16 bits
+};
+
+// visibility table header, rows of the table and visible counts of every waypoint follow it
+struct VisTableHeader
+{
+	char header[8];
+	int32_t fileVersion;
+	int32_t pointNumber;
+	uint32_t pointHash; // hash of the waypoint positions the table was traced from
+	uint32_t dataHash; // hash of everything after the header
+};
+
 // define general waypoint structure
 struct Path
 {
@@ -685,6 +813,7 @@ struct Path
 class Bot
 {
 	friend class BotControl;
+	friend class Blackboard;
 
 private:
 	unsigned int m_states; // sensing bitstates
@@ -743,6 +872,15 @@ private:
 
 	PathNode* m_navNode; // pointer to current node from path
 	PathNode* m_navNodeStart; // pointer to start of path finding nodes
+
+	int m_pathRequestSrc; // source index of pending path search
+	int m_pathRequestDest; // destination index of pending path search (-1 if none)
+	int m_pathRetryIndex; // source index of failed path search
+	int m_pathGoalIndex; // goal the current path was searched for, path may end before it (-1 if none)
+	bool m_planQueued; // plan think of this bot is pushed to the job system and not run yet
+	int m_pathRequestProfile; // cost profile of pending path search
+	PathHeuristicFunc m_pathRequestHeuristic; // heuristic function of pending path search
+	SearchWorkspace* m_searchState; // A* state of this bot, held from a pool only while a long search is split over frames
 	uint8_t m_visibility; // visibility flags
 
 	int m_currentWaypointIndex; // current waypoint index
@@ -993,12 +1131,15 @@ private:
 	int GetCampAimingWaypoint(void);
 	int GetAimingWaypoint(Vector targetOriginPos);
 	void FindPath(int srcIndex, int destIndex);
+	int SearchPath(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int maxExpansions);
+	void SetPath(const vector <int16>& path);
+	void DeleteSearchState(void);
+	void CheckPathRetry(void);
 	void SecondThink(void);
 	void CalculatePing(void);
 
 public:
 	entvars_t* pev;
-	AStar_t waypoints[Const_MaxWaypoints];
 
 	edict_t* m_enemyAPI;
 	bool m_moveAIAPI = false;
@@ -1155,6 +1296,7 @@ public:
 	inline Vector EarPosition(void) { return pev->origin + pev->view_ofs; };
 
 	void Think(void);
+	void PlanThink(int maxExpansions);
 	void FacePosition(void);
 	void UpdateAI(void);
 	void NewRound(void);
@@ -1220,6 +1362,7 @@ private:
 	float m_maintainTime; // time to maintain bot creation quota
 	int m_lastWinner; // the team who won previous round
 	int m_roundCount; // rounds passed
+	int m_pathExpansions; // A* expansions each path search may do in this frame (0 = unlimited)
 	bool m_economicsGood[2]; // is team able to buy anything
 
 protected:
@@ -1239,6 +1382,8 @@ public:
 	int GetLastWinner(void) const { return m_lastWinner; }
 	void SetLastWinner(int winner) { m_lastWinner = winner; }
 
+	int GetPathExpansions(void) const { return m_pathExpansions; }
+
 	int GetIndex(edict_t* ent);
 	Bot* GetBot(int index);
 	Bot* GetBot(edict_t* ent);
@@ -1303,11 +1448,26 @@ public:
 class Waypoint : public Singleton <Waypoint>
 {
 	friend class Bot;
+	friend class Blackboard;
 
 private:
-	Path* m_paths[Const_MaxWaypoints];
+	vector <Path*> m_paths;
+	// path in the arena knows its slot, so it can be freed without looking for its block
+	struct PathSlot
+	{
+		Path path;
+		int slot;
+	};
+
+	vector <PathSlot*> m_pathBlocks; // paths are allocated from these blocks, so they stay close in memory and never move
+	vector <int> m_freePaths; // free slots of the blocks, lowest on top after ResetPaths
 	bool m_badMapName;
 
+	Path* AllocPath(void);
+	void FreePath(Path* path);
+	void ResetPaths(void);
+	void ReserveWaypoints(int count);
+
 	bool m_isOnLadder;
 	bool m_waypointPaths;
 	bool m_endJumpPoint;
@@ -1327,22 +1487,81 @@ private:
 
 	int m_cacheWaypointIndex;
 	int m_lastJumpWaypoint;
-	int m_visibilityIndex;
+	int m_visibilityIndex; // row and column the time sliced visibility build continues from
+	int m_visibilityColumn;
 	Vector m_lastWaypoint;
-	uint8_t m_visLUT[Const_MaxWaypoints][Const_MaxWaypoints / 4];
+	// bit per destination waypoint, set if it is visible from the row waypoint. rows are padded to 128 bits
+	vector <uint32_t> m_standVisibility;
+	vector <uint32_t> m_crouchVisibility;
+	int m_visibilityWords; // words per row
+	int m_visibilityNum; // number of waypoints the rows cover
 
 	int m_lastDeclineWaypoint;
 
 	float m_pathDisplayTime;
 	float m_arrowDisplayTime;
-	float m_waypointDisplayTime[Const_MaxWaypoints];
-	float m_goalsScore[Const_MaxWaypoints];
+	vector <float> m_waypointDisplayTime;
+	vector <float> m_goalsScore;
 	int m_findWPIndex;
 	int m_facingAtIndex;
 	char m_infoBuffer[256];
 
-	int* m_distMatrix;
-	int* m_pathMatrix;
+	const uint16* m_distMatrix; // 0xffff = unreachable
+	const uint16* m_pathMatrix; // 0xffff = no next hop
+	vector <uint16> m_matrixBuffer;
+	MappedFile m_matrixFile;
+	int m_distShift;
+	int m_matrixSize; // number of waypoints the matrices cover
+	int m_matrixStride; // row length of the matrices
+	bool m_matrixEditing; // matrices are the private copy edits work on
+	vector <uint8_t> m_matrixDirtyRows; // rows to search again on the next UpdatePathMatrix
+
+	bool PrepareMatrixEdit(void);
+	void FitDistanceShift(int maxDist);
+	void AddPathToMatrix(int srcIndex, int destIndex, int distance);
+	void RemovePathFromMatrix(int srcIndex, int destIndex, int distance);
+	void RemoveWaypointFromMatrix(int index);
+	void UpdatePathMatrix(void);
+
+	vector <int> m_component; // strongly connected component of every waypoint
+	int m_numComponents;
+	vector <int> m_componentKey; // index among components of several waypoints, -1 for single waypoint
+	int m_numKeys;
+	int m_keyWords;
+	vector <uint32_t> m_keyReach; // bit per key component that can be reached from the key component
+	vector <int> m_predFirst; // incoming links of every waypoint, walked back from single waypoints
+	vector <int16> m_predIndex;
+	vector <uint32_t> m_reachMark; // visit stamps of the walks in IsReachable
+	uint32_t m_reachStamp;
+	bool m_componentsDirty;
+
+	// connections of all waypoints packed one after another, -1 slots are left out
+	vector <int> m_linkFirst;
+	vector <int16> m_linkIndex;
+	int m_linksNum;
+	bool m_linksDirty;
+
+	// waypoints bucketed by 2D cells for nearest, radius and farest searches
+	vector <vector <int> > m_grid;
+	float m_gridMinX;
+	float m_gridMinY;
+	float m_gridMinZ;
+	float m_gridMaxZ;
+	float m_gridCellSize;
+	int m_gridWidth;
+	int m_gridHeight;
+	int m_gridNumWaypoints;
+	bool m_gridDirty;
+
+	// origins of the waypoints as separate arrays, grid searches read these instead of the paths
+	vector <float> m_originX;
+	vector <float> m_originY;
+	vector <float> m_originZ;
+
+	void InitGrid(void);
+	void AddToGrid(int index);
+	void GetGridCell(const Vector& origin, int& x, int& y);
+	void FindInGridRadius(const Vector& origin, float radius, vector <int>& result);
 
 	Array <int> m_terrorPoints;
 	Array <int> m_ctPoints;
@@ -1367,6 +1586,8 @@ public:
 	void Analyze(void);
 	void AnalyzeDeleteUselessWaypoints(void);
 	void InitTypes();
+	void InitComponents(void);
+	bool IsReachable(int srcIndex, int destIndex);
 	void AddPath(int addIndex, int pathIndex, float distance, int type = 0);
 
 	int GetFacingIndex(void);
@@ -1386,6 +1607,10 @@ public:
 	bool IsConnected(int pointA, int pointB);
 	bool IsConnected(int num);
 	void InitializeVisibility(void);
+	void ThinkVisibility(void);
+	void SaveVisibility(void);
+	bool LoadVisibility(void);
+	uint32_t GetVisibilityHash(void);
 	void CreatePath(char dir);
 	void DeletePath(void);
 	void CacheWaypoint(void);
@@ -1399,6 +1624,11 @@ public:
 	bool IsVisible(int srcIndex, int destIndex);
 	bool IsStandVisible(int srcIndex, int destIndex);
 	bool IsDuckVisible(int srcIndex, int destIndex);
+
+	int GetVisibilityWords(void) { return m_visibilityWords; }
+	void GetVisibleSet(int srcIndex, int rows, vector <uint32_t>& result);
+	void GetVisibleExcept(int srcIndex, int hiddenIndex, int rows, vector <uint32_t>& result);
+	int CountVisible(int srcIndex, const vector <uint32_t>& mask, int rows);
 	void CalculateWayzone(int index);
 
 	bool Load(int mode = 0);
@@ -1417,11 +1647,32 @@ public:
 	void InitPathMatrix(void);
 	void SavePathMatrix(void);
 	bool LoadPathMatrix(void);
+	uint32_t GetGraphHash(void);
+	void SaveSections(File& fp);
+	bool LoadSections(File& fp);
+	bool IsPackedTableValid(int section, const vector <uint8_t>& data);
 
+	int GetNextHop(int srcIndex, int destIndex);
 	int GetPathDistance(int srcIndex, int destIndex);
 	float GetPathDistanceFloat(int srcIndex, int destIndex);
 
 	Path* GetPath(int id);
+
+	void UpdateLinks(void);
+
+	// returns the connections of the waypoint, packed ones if they are up to date. -1 must be skipped
+	inline const int16* GetLinks(int index, int& count)
+	{
+		if (!m_linksDirty && index < m_linksNum)
+		{
+			count = m_linkFirst[index + 1] - m_linkFirst[index];
+			return m_linkIndex.data() + m_linkFirst[index];
+		}
+
+		count = Const_MaxPathIndex;
+		return m_paths[index]->index;
+	}
+
 	char* GetWaypointInfo(int id);
 	char* GetInfo(void) { return m_infoBuffer; }
 
@@ -1436,15 +1687,258 @@ public:
 	Vector GetBombPosition(void) { return m_foundBombOrigin; }
 	void SetBombPosition(bool shouldReset = false);
 	String CheckSubfolderFile(void);
+};
+
+// worker thread pool with per frame barrier
+class JobSystem : public Singleton <JobSystem>
+{
+private:
+	struct Job
+	{
+		const char* name;
+		function <void(void)> func;
+	};
+
+	struct JobStats
+	{
+		const char* name;
+		int calls;
+		double totalTime; // in microseconds
+		double maxTime;
+	};
+
+	vector <thread> m_workers;
+	vector <Job> m_parallelJobs;
+	vector <Job> m_engineJobs;
+	vector <JobStats> m_stats;
+
+	mutex m_queueLock;
+	mutex m_statsLock;
+	condition_variable m_wakeUp;
+	condition_variable m_jobsDone;
+
+	int m_nextParallelJob;
+	int m_runningJobs;
+	bool m_shutdown;
+	bool m_engineJobsRunning; // workers hold parallel jobs pushed by engine jobs until the next pass
+
+	void WorkerThread(void);
+	void Execute(const Job& job);
+	bool RunParallelJob(bool worker = false);
+	bool HasParallelJob(void) const { return m_nextParallelJob < static_cast <int> (m_parallelJobs.size()); }
+
+public:
+	JobSystem(void);
+	~JobSystem(void);
+
+	void Initialize(void);
+	void Destroy(void);
+
+	void Push(const char* name, function <void(void)> func, JobType type = JOB_ENGINE);
+	void Wait(void);
+
+	int GetWorkersNum(void) const { return static_cast <int> (m_workers.size()); }
+	bool IsRunningEngineJobs(void) const { return m_engineJobsRunning; }
+	void PrintStats(edict_t* ent);
+	void ResetStats(void);
+};
+
+// per tick node costs for path searches
+class PathCostTable : public Singleton <PathCostTable>
+{
+private:
+	vector <float> m_cost[PATHCOST_NUM][TEAM_COUNT][2];
+	float m_updateTime[PATHCOST_NUM][TEAM_COUNT][2];
+	bool m_requested[PATHCOST_NUM][TEAM_COUNT][2];
+	int m_numWaypoints[PATHCOST_NUM][TEAM_COUNT][2];
+	uint32_t m_generation[PATHCOST_NUM][TEAM_COUNT][2]; // bumped only when costs really changed
+	float m_distScale[PATHCOST_NUM][TEAM_COUNT][2]; // lowest cost per unit of link length
+
+	vector <uint8_t> m_fallBlocked;
+	float m_fallUpdateTime;
+	int m_fallNumWaypoints;
+	uint32_t m_fallGeneration;
+
+	void Build(int profile, int team, bool isZombie);
+	void BuildFallCheck(void);
+
+public:
+	PathCostTable(void);
+	~PathCostTable(void) { };
+
+	void Request(int profile, int team, bool isZombie);
+	void Update(void);
+	void Prepare(int profile, int team, bool isZombie);
+	void Reset(void);
+
+	float GetCost(int profile, int index, int parent, int team, float gravity, bool isZombie);
+	uint32_t GetEpoch(int profile, int team, bool isZombie) const { return m_generation[profile][team][isZombie ? 1 : 0] + (m_fallGeneration << 20); }
+	float GetDistanceScale(int profile, int team, bool isZombie) const;
+};
+
+const int Const_PathCacheSize = 512;
+const int Const_PathCacheBuckets = 1024; // power of two, twice the entries keeps the probe chains short
+
+// found paths shared between all bots
+class PathCache : public Singleton <PathCache>
+{
+private:
+	struct Entry
+	{
+		int srcIndex;
+		int destIndex;
+		int profile;
+		int team;
+		int gravity;
+		bool isZombie;
+		PathHeuristicFunc heuristic;
+
+		uint32_t epoch;
+		uint32_t threat; // coarse threat the path was found with, see ThreatMap::GetGeneration ()
+		uint32_t lastUse;
+		shared_ptr <const vector <int16> > path;
+	};
+
+	Entry m_entries[Const_PathCacheSize];
+	int16 m_buckets[Const_PathCacheBuckets]; // open addressing from key hash to entry, -1 = empty
+	int m_numEntries;
+	uint32_t m_useCounter;
+
+	int m_hits;
+	int m_misses;
+
+	mutex m_lock;
+
+	static uint32_t HashKey(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, int gravity, bool isZombie);
+	int FindEntry(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, int gravity, bool isZombie);
+	void RemoveEntry(int index);
+
+public:
+	PathCache(void);
+	~PathCache(void) { };
+
+	shared_ptr <const vector <int16> > Find(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie);
+	void Insert(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie, shared_ptr <const vector <int16> > path);
+
+	void Clear(void);
+	void PrintStats(edict_t* ent);
+};
+
+const int Const_MaxLandmarks = 8;
+
+// path distances from and to a few landmark waypoints, gives lower bound of path length for A* (ALT)
+class LandmarkTable : public Singleton <LandmarkTable>
+{
+private:
+	int m_landmarks[Const_MaxLandmarks];
+	int m_numLandmarks;
+	int m_numWaypoints;
+
+	vector <float> m_distFrom; // landmark to waypoint, Const_MaxLandmarks * m_numWaypoints
+	vector <float> m_distTo; // waypoint to landmark
+
+	void Dijkstra(int source, bool reverse, float* dist);
+
+public:
+	LandmarkTable(void);
+	~LandmarkTable(void) { };
+
+	void Build(void);
+	bool IsValid(void) const;
+	float GetBound(int start, int goal) const;
+};
+
+const float Const_ClusterSize = 1024.0f;
+const float Const_ClusterHeight = 512.0f;
+
+// waypoints grouped by area, long paths are planned over the cluster entrances first (HPA*)
+class PathClusters : public Singleton <PathClusters>
+{
+private:
+	int m_numWaypoints;
+	int m_numClusters;
+	vector <int> m_cluster;
+	vector <int> m_abstractIndex; // -1 if waypoint isn't an entrance
+
+	vector <int> m_entrances; // waypoint of every abstract node
+
+	// abstract graph, connections between entrances
+	vector <int> m_edgeFirst;
+	vector <int> m_edgeTarget;
+	vector <float> m_edgeCost;
+
+	// incoming connections of every waypoint
+	vector <int> m_inFirst;
+	vector <int> m_inSource;
+	vector <float> m_inCost;
+
+	// entrances of every cluster, and distances between every waypoint and the entrances of its cluster
+	vector <int> m_clusterFirst;
+	vector <int> m_clusterEntrances; // abstract nodes
+	vector <int> m_entranceSlot; // position of the abstract node in its cluster
+	vector <int> m_distFirst;
+	vector <float> m_toEntrance;
+	vector <float> m_fromEntrance;
+
+	void SearchCluster(int source, bool reverse, vector <float>& dist);
+
+public:
+	PathClusters(void);
+	~PathClusters(void) { };
+
+	void Build(void);
+	bool IsValid(void) const;
+	int GetNextGoal(int srcIndex, int destIndex, int& expansions);
+
+	int GetClustersNum(void) const { return m_numClusters; }
+	int GetEntrancesNum(void) const { return static_cast <int> (m_entrances.size()); }
+};
+
+const float Const_ThreatDeath = 100.0f; // threat of a teammate killed at the waypoint
+const float Const_ThreatSighting = 25.0f; // threat of an enemy seen at the waypoint
+const float Const_ThreatSound = 10.0f; // threat of an enemy heard at the waypoint
+const float Const_ThreatMax = 1000.0f;
+const float Const_ThreatCacheLevel = 5.0f; // cached paths are outdated when threat of a waypoint crosses this
+
+// short term danger of every waypoint for each team, raised by fights and faded out over time
+class ThreatMap : public Singleton <ThreatMap>
+{
+private:
+	vector <float> m_threat[TEAM_COUNT]; // padded to multiple of 4 for the decay
+	uint32_t m_generation[TEAM_COUNT]; // bumped when some waypoint gets above or below Const_ThreatCacheLevel
+	int m_numWaypoints;
+	float m_decayTime;
+
+public:
+	ThreatMap(void);
+	~ThreatMap(void) { };
+
+	void Think(void);
+	void Reset(void);
+	void AddThreat(int index, int team, float amount);
+
+	// returns the threat for the team at the waypoint, cheap enough for path costs
+	inline float GetThreat(int index, int team) const
+	{
+		if (index < 0 || index >= m_numWaypoints || team < 0 || team >= TEAM_COUNT)
+			return 0.0f;
+
+		return m_threat[team][index];
+	}
 
-	int* GetWaypointPath() { return m_pathMatrix; }
-	int* GetWaypointDist() { return m_distMatrix; }
+	uint32_t GetGeneration(int team) const { return (team >= 0 && team < TEAM_COUNT) ? m_generation[team] : 0; }
 };
 
 #define g_netMsg NetworkMsg::GetObjectPtr ()
 #define g_botManager BotControl::GetObjectPtr ()
 #define g_localizer Localizer::GetObjectPtr ()
 #define g_waypoint Waypoint::GetObjectPtr ()
+#define g_jobs JobSystem::GetObjectPtr ()
+#define g_pathCost PathCostTable::GetObjectPtr ()
+#define g_pathCache PathCache::GetObjectPtr ()
+#define g_landmarks LandmarkTable::GetObjectPtr ()
+#define g_pathClusters PathClusters::GetObjectPtr ()
+#define g_threatMap ThreatMap::GetObjectPtr ()
 
 // prototypes of bot functions...
 extern int GetWeaponReturn(bool isString, const char* weaponAlias, int weaponID = -1);
@@ -1491,6 +1985,7 @@ extern bool IsWeaponShootingThroughWall(int id);
 extern bool IsValidBot(edict_t* ent);
 extern bool IsValidPlayer(edict_t* ent);
 extern bool OpenConfig(const char* fileName, char* errorIfNotExists, File* outFile);
+extern uint32_t HashBytes(uint32_t hash, const void* data, int size);
 extern bool FindNearestPlayer(void** holder, edict_t* to, float searchDistance = 4096.0, bool sameTeam = false, bool needBot = false, bool needAlive = false, bool needDrawn = false);
 
 extern const char* GetEntityName(edict_t* entity);
@@ -1536,6 +2031,8 @@ extern void MOD_AddLogEntry(int mode, char* format);
 extern void DisplayMenuToClient(edict_t* ent, MenuText* menu);
 extern void DecalTrace(entvars_t* pev, TraceResult* trace, int logotypeIndex);
 extern void SoundAttachToThreat(edict_t* ent, const char* sample, float volume);
+extern void BenchmarkPathfinding(edict_t* ent, int count);
+extern void BenchmarkHeuristics(edict_t* ent, int count);
 
 extern void TraceLine(const Vector& start, const Vector& end, bool ignoreMonsters, bool ignoreGlass, edict_t* ignoreEntity, TraceResult* ptr);
 extern void TraceLine(const Vector& start, const Vector& end, bool ignoreMonsters, edict_t* ignoreEntity, TraceResult* ptr);
@@ -1559,5 +2056,6 @@ extern ConVar ebot_gamemod;
 #include <resource.h>
 
 #include <Experience.h>
+#include <world.h>
 
 #endif // EBOT_INCLUDED
@@ -73,11 +73,67 @@ private:
         int16 value[TEAM_COUNT];
     };
 
+    //
+    // Struct: ExpPair
+    // Represents experience data between two different waypoints.
+    //
+    struct ExpPair
+    {
+        //
+        // Variable: goal
+        // Other waypoint of the pair.
+        //
+        int goal;
+
+        //
+        // Variable: data
+        // Experience data of the pair.
+        //
+        ExpData data;
+    };
+
     //
     // Variable: m_data
-    // Holds all in-game experience info for waypoints.
+    // Holds experience info of every waypoint with itself.
+    //
+    vector <ExpData> m_data;
+
+    //
+    // Variable: m_pairs
+    // Holds experience info between different waypoints, only pairs that were ever written. Rows are sorted by goal.
+    //
+    vector <vector <ExpPair> > m_pairs;
+
+    //
+    // Struct: ExpRowMax
+    // Represents the most damaging pair of a waypoint, kept up to date on every write.
+    //
+    struct ExpRowMax
+    {
+        //
+        // Variable: damage
+        // Highest damage of the row.
+        //
+        uint16_t damage[TEAM_COUNT];
+
+        //
+        // Variable: index
+        // Lowest goal with the highest damage, -1 if the row has no damage.
+        //
+        int16 index[TEAM_COUNT];
+    };
+
+    //
+    // Variable: m_rowMax
+    // Holds the most damaging pair of every waypoint.
+    //
+    vector <ExpRowMax> m_rowMax;
+
     //
-    ExpData* m_data;
+    // Variable: m_damageScale
+    // Kill history decay of waypoint damage, stored damage of waypoint with itself is multiplied by it when read.
+    //
+    float m_damageScale[TEAM_COUNT];
 
     //
     // Variable: m _history
@@ -85,16 +141,74 @@ private:
     //
     uint16_t m_history;
 
-public:
-    BotExperience(void) { }
+    //
+    // Struct: ExpSnapshot
+    // Represents a copy of experience data, used while it's loaded or saved in background.
+    //
+    struct ExpSnapshot
+    {
+        //
+        // Variable: data
+        // Experience of every waypoint with itself, damage is already scaled.
+        //
+        vector <ExpData> data;
+
+        //
+        // Variable: pairs
+        // Experience between different waypoints, rows are sorted by goal.
+        //
+        vector <vector <ExpPair> > pairs;
+    };
+
+    //
+    // Variable: m_base
+    // Experience that is in the file already, only the difference to it is added to the file on save.
+    //
+    ExpSnapshot m_base;
+
+    //
+    // Variable: m_loadTask
+    // Reads the experience file in background, result is taken by Think.
+    //
+    future <shared_ptr <ExpSnapshot> > m_loadTask;
+
+    //
+    // Variable: m_saveTask
+    // Writes the experience file in background.
+    //
+    shared_future <void> m_saveTask;
 
-    inline ~BotExperience(void)
+    //
+    // Variable: m_fileName
+    // Experience file of the loaded waypoints.
+    //
+    String m_fileName;
+
+    //
+    // Variable: m_graphHash
+    // Hash of the waypoint links the experience belongs to.
+    //
+    uint32_t m_graphHash;
+
+    //
+    // Variable: m_savePending
+    // Save was asked while the file was still read, it's done when the file is merged.
+    //
+    bool m_savePending;
+
+public:
+    BotExperience(void)
     {
-        if (m_data != nullptr)
-            delete[] m_data;
-        m_data = nullptr;
+        m_history = 0;
+        m_graphHash = 0;
+        m_savePending = false;
+
+        for (int t = 0; t < TEAM_COUNT; t++)
+            m_damageScale[t] = 1.0f;
     }
 
+    ~BotExperience(void) { }
+
     //
     // Group: Public accessible methods.
     //
@@ -185,6 +299,28 @@ public:
     //
     void Unload(void);
 
+    //
+    // Function: Save
+    //
+    // Writes collected experience to the experience file in background. Experience that other servers
+    // added to the file meanwhile is kept.
+    //
+    void Save(void);
+
+    //
+    // Function: Think
+    //
+    // Takes the experience file once it's read in background, should be called every frame.
+    //
+    void Think(void);
+
+    //
+    // Function: Flush
+    //
+    // Waits until the experience file is read and written, must be called before the dll is unloaded.
+    //
+    void Flush(void);
+
     //
     // Function: DrawText
     //
@@ -274,7 +410,11 @@ public:
     //
     inline uint16_t GetDamage(int start, int goal, int team) const
     {
-        return (m_data + (start * g_numWaypoints) + goal)->damage[team]; // just return data
+        if (start == goal)
+            return static_cast <uint16_t> (m_data[start].damage[team] * m_damageScale[team]); // just return data
+
+        const ExpData* data = FindPair(start, goal);
+        return data != nullptr ? data->damage[team] : 0;
     }
 
     //
@@ -295,7 +435,11 @@ public:
     //
     inline int16 GetValue(int start, int goal, int team) const
     {
-        return (m_data + (start * g_numWaypoints) + goal)->value[team]; // just return data
+        if (start == goal)
+            return m_data[start].value[team]; // just return data
+
+        const ExpData* data = FindPair(start, goal);
+        return data != nullptr ? data->value[team] : 0;
     }
 
     //
@@ -316,7 +460,11 @@ public:
     //
     inline int16 GetDangerIndex(int start, int goal, int team) const
     {
-        return (m_data + (start * g_numWaypoints) + goal)->danger[team]; // just return data
+        if (start == goal)
+            return m_data[start].danger[team]; // just return data
+
+        const ExpData* data = FindPair(start, goal);
+        return data != nullptr ? data->danger[team] : -1;
     }
 
     inline int GetKillHistory(void)
@@ -326,12 +474,172 @@ public:
 
     inline float GetAStarValue(int point, int team, bool dist)
     {
-        return static_cast <float> ((m_data + (point * g_numWaypoints) + point)->damage[team] + (dist ? m_history : 0)); // just return data
+        return static_cast <float> (GetDamage(point, point, team) + (dist ? m_history : 0)); // just return data
     }
     //
     // Group: Private Functions.
     //
 private:
+    //
+    // Function: FindPair
+    //
+    // Finds experience data between two different waypoints.
+    //
+    // Parameters:
+    //   start - Start waypoint.
+    //   goal - Goal waypoint.
+    //
+    // Returns:
+    //   Pointer to the data, or nullptr if nothing was written for the pair yet.
+    //
+    inline const ExpData* FindPair(int start, int goal) const
+    {
+        return FindInRow(m_pairs[start], goal);
+    }
+
+    //
+    // Function: FindInRow
+    //
+    // Finds experience data of the goal in a row of pairs.
+    //
+    // Parameters:
+    //   row - Row of pairs sorted by goal.
+    //   goal - Goal waypoint.
+    //
+    // Returns:
+    //   Pointer to the data, or nullptr if the row doesn't have the goal.
+    //
+    static inline const ExpData* FindInRow(const vector <ExpPair>& row, int goal)
+    {
+        int low = 0, high = static_cast <int> (row.size()) - 1;
+
+        while (low <= high)
+        {
+            int middle = (low + high) / 2;
+
+            if (row[middle].goal == goal)
+                return &row[middle].data;
+
+            if (row[middle].goal < goal)
+                low = middle + 1;
+            else
+                high = middle - 1;
+        }
+
+        return nullptr;
+    }
+
+    //
+    // Function: GetData
+    //
+    // Gets experience data for writing, the pair is added if it doesn't exist yet.
+    //
+    // Parameters:
+    //   start - Start waypoint.
+    //   goal - Goal waypoint.
+    //
+    // Returns:
+    //   Pointer to the data.
+    //
+    ExpData* GetData(int start, int goal);
+
+    //
+    // Function: AddToRow
+    //
+    // Finds experience data of the goal in a row of pairs, the goal is added if the row doesn't have it.
+    //
+    // Parameters:
+    //   row - Row of pairs sorted by goal.
+    //   goal - Goal waypoint.
+    //
+    // Returns:
+    //   Pointer to the data.
+    //
+    static ExpData* AddToRow(vector <ExpPair>& row, int goal);
+
+    //
+    // Function: RebuildRowMax
+    //
+    // Finds the most damaging pair of the waypoint again.
+    //
+    // Parameters:
+    //   start - Start waypoint.
+    //   team - Team of the damage.
+    //
+    void RebuildRowMax(int start, int team);
+
+    //
+    // Function: TakeSnapshot
+    //
+    // Copies the current experience.
+    //
+    // Parameters:
+    //   snapshot - Holder for the copy.
+    //
+    void TakeSnapshot(ExpSnapshot& snapshot);
+
+    //
+    // Function: AdoptLoaded
+    //
+    // Replaces the experience with the one read from file, experience collected meanwhile is added to it.
+    //
+    void AdoptLoaded(void);
+
+    //
+    // Function: Merge
+    //
+    // Adds the difference between two snapshots to the target. Pairs that aren't in a snapshot count as zero.
+    //
+    // Parameters:
+    //   target - Snapshot to change.
+    //   current - New experience.
+    //   base - Old experience, may be empty.
+    //
+    static void Merge(ExpSnapshot& target, const ExpSnapshot& current, const ExpSnapshot& base);
+
+    //
+    // Function: ReadFile
+    //
+    // Reads an experience file, it's used from background threads so it doesn't touch the engine.
+    //
+    // Parameters:
+    //   fileName - Experience file.
+    //   graphHash - Hash of the waypoint links the file must belong to.
+    //   numWaypoints - Number of waypoints the file must have.
+    //   snapshot - Holder for the read experience.
+    //
+    // Returns:
+    //   True if file was read and belongs to the waypoints, false otherwise.
+    //
+    static bool ReadFile(const String& fileName, uint32_t graphHash, int numWaypoints, ExpSnapshot& snapshot);
+
+    //
+    // Function: WriteFile
+    //
+    // Writes an experience file, it's used from background threads so it doesn't touch the engine.
+    //
+    // Parameters:
+    //   fileName - Experience file.
+    //   graphHash - Hash of the waypoint links the experience belongs to.
+    //   snapshot - Experience to write.
+    //
+    // Returns:
+    //   True if file was written, false otherwise.
+    //
+    static bool WriteFile(const String& fileName, uint32_t graphHash, const ExpSnapshot& snapshot);
+
+    //
+    // Function: UpdateRowMax
+    //
+    // Updates the most damaging pair of the waypoint after damage of the pair is changed.
+    //
+    // Parameters:
+    //   start - Start waypoint.
+    //   goal - Goal waypoint.
+    //   oldDamage - Damage of the pair before the change.
+    //   team - Team of the damage.
+    //
+    void UpdateRowMax(int start, int goal, int oldDamage, int team);
     //
     // Function: SetDamage
     //
@@ -112,4 +112,6 @@ extern FuncPointers_t g_funcPointers;
 extern NewEntityAPI_t g_getNewEntityAPI;
 extern BlendAPI_t g_serverBlendingAPI;
 
+extern mutex g_traceLock;
+
 #endif // GLOBALS_INCLUDED
@@ -84,7 +84,9 @@ typedef void (*EntityPtr_t) (entvars_t*);
 #include <unistd.h>
 #include <dlfcn.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #define DLL_ENTRYPOINT void _fini (void)
 #define DLL_DETACHING TRUE
@@ -158,4 +160,125 @@ public:
     }
 };
 
+#ifdef PLATFORM_WIN32
+extern "C" void* __stdcall CreateFileA(const char*, unsigned long, unsigned long, void*, unsigned long, unsigned long, void*);
+extern "C" void* __stdcall CreateFileMappingA(void*, void*, unsigned long, unsigned long, unsigned long, const char*);
+extern "C" void* __stdcall MapViewOfFile(void*, unsigned long, unsigned long, unsigned long, size_t);
+extern "C" int __stdcall UnmapViewOfFile(const void*);
+extern "C" unsigned long __stdcall GetFileSize(void*, unsigned long*);
+extern "C" int __stdcall CloseHandle(void*);
+#endif
+
+// read only memory mapped file, pages are loaded on first access and shared between processes
+class MappedFile
+{
+private:
+    void* m_data;
+    int m_size;
+
+#ifdef PLATFORM_WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+public:
+    MappedFile(void) : m_data(NULL), m_size(0)
+    {
+#ifdef PLATFORM_WIN32
+        m_file = NULL;
+        m_mapping = NULL;
+#endif
+    }
+
+    ~MappedFile(void)
+    {
+        Close();
+    }
+
+public:
+    bool Open(const char* fileName)
+    {
+        Close();
+
+#ifdef PLATFORM_WIN32
+        m_file = CreateFileA(fileName, 0x80000000 /* GENERIC_READ */, 0x00000001 /* FILE_SHARE_READ */, NULL, 3 /* OPEN_EXISTING */, 0x80 /* FILE_ATTRIBUTE_NORMAL */, NULL);
+
+        if (m_file == reinterpret_cast <void*> (-1))
+        {
+            m_file = NULL;
+            return false;
+        }
+
+        m_size = static_cast <int> (GetFileSize(m_file, NULL));
+        m_mapping = m_size > 0 ? CreateFileMappingA(m_file, NULL, 0x02 /* PAGE_READONLY */, 0, 0, NULL) : NULL;
+
+        if (m_mapping != NULL)
+            m_data = MapViewOfFile(m_mapping, 0x0004 /* FILE_MAP_READ */, 0, 0, 0);
+#else
+        int file = open(fileName, O_RDONLY);
+
+        if (file == -1)
+            return false;
+
+        struct stat info;
+
+        if (fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            m_size = static_cast <int> (info.st_size);
+            m_data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, file, 0);
+
+            if (m_data == MAP_FAILED)
+                m_data = NULL;
+        }
+
+        // mapping stays valid after the descriptor is closed
+        close(file);
+#endif
+
+        if (m_data == NULL)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close(void)
+    {
+#ifdef PLATFORM_WIN32
+        if (m_data != NULL)
+            UnmapViewOfFile(m_data);
+
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+
+        if (m_file != NULL)
+            CloseHandle(m_file);
+
+        m_file = NULL;
+        m_mapping = NULL;
+#else
+        if (m_data != NULL)
+            munmap(m_data, m_size);
+#endif
+        m_data = NULL;
+        m_size = 0;
+    }
+
+    inline const void* GetData(void) const
+    {
+        return m_data;
+    }
+
+    inline int GetSize(void) const
+    {
+        return m_size;
+    }
+
+    inline bool IsValid(void) const
+    {
+        return m_data != NULL;
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,333 @@
+//
+// Copyright (c) 2003-2009, by Yet Another POD-Bot Development Team.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// $Id$
+//
+
+
+#ifndef WORLD_INCLUDED
+#define WORLD_INCLUDED
+
+//
+// Enum: WorldFlags
+// Flags of players and entities in world snapshot.
+//
+enum WorldFlags
+{
+    WORLD_USED = (1 << 0), // slot is used
+    WORLD_ALIVE = (1 << 1), // player or entity is alive
+    WORLD_ZOMBIE = (1 << 2), // player is zombie
+    WORLD_HIDDEN = (1 << 3) // entity is not drawn or can't take damage
+};
+
+//
+// Class: WorldState
+// Immutable per frame snapshot of players and tracked entities, shared by all bots.
+//
+// Remarks:
+//   Built once per frame on the engine thread, so worker threads can read it without any lock
+//   and bots don't need to ask engine about every client again.
+//
+class WorldState
+{
+    //
+    // Group: Players.
+    //
+public:
+
+    //
+    // Variable: maxClients
+    // Number of player slots filled in this snapshot.
+    //
+    int maxClients;
+
+    //
+    // Variable: playerEnt
+    // Edict of each player, index is client index - 1.
+    //
+    edict_t* playerEnt[32];
+
+    //
+    // Variable: playerOrigin
+    // Origin of each player.
+    //
+    Vector playerOrigin[32];
+
+    //
+    // Variable: playerVelocity
+    // Velocity of each player.
+    //
+    Vector playerVelocity[32];
+
+    //
+    // Variable: playerEyePosition
+    // Eye position of each player.
+    //
+    Vector playerEyePosition[32];
+
+    //
+    // Variable: playerTeam
+    // Team of each player.
+    //
+    int playerTeam[32];
+
+    //
+    // Variable: playerWaypoint
+    // Current waypoint of each player.
+    //
+    int playerWaypoint[32];
+
+    //
+    // Variable: playerPing
+    // Real ping of each player, only filled while fake ping is needed.
+    //
+    int playerPing[32];
+
+    //
+    // Variable: playerFlags
+    // See <WorldFlags>.
+    //
+    int playerFlags[32];
+
+    //
+    // Group: Entities.
+    //
+public:
+
+    //
+    // Variable: entityEnt
+    // Edict of each tracked entity, index is same as in g_entityId.
+    //
+    edict_t* entityEnt[entityNum];
+
+    //
+    // Variable: entityOrigin
+    // Origin of each tracked entity.
+    //
+    Vector entityOrigin[entityNum];
+
+    //
+    // Variable: entityTeam
+    // Team of each tracked entity.
+    //
+    int entityTeam[entityNum];
+
+    //
+    // Variable: entityAction
+    // Action of each tracked entity.
+    //
+    int entityAction[entityNum];
+
+    //
+    // Variable: entityWaypoint
+    // Current waypoint of each tracked entity.
+    //
+    int entityWaypoint[entityNum];
+
+    //
+    // Variable: entityFlags
+    // See <WorldFlags>.
+    //
+    int entityFlags[entityNum];
+
+    //
+    // Group: Functions.
+    //
+public:
+
+    //
+    // Function: WorldState
+    //
+    // Default world state constructor.
+    //
+    WorldState(void);
+
+    //
+    // Function: Update
+    //
+    // Rebuilds the snapshot, must be called from engine thread.
+    //
+    void Update(void);
+
+    //
+    // Function: IsAlivePlayer
+    //
+    // Checks if player slot holds alive player.
+    //
+    // Parameters:
+    //   index - Player index.
+    //
+    // Returns:
+    //   True if player is alive, false otherwise.
+    //
+    inline bool IsAlivePlayer(int index) const
+    {
+        return (playerFlags[index] & WORLD_ALIVE) != 0;
+    }
+};
+
+extern WorldState g_world;
+
+//
+// Class: Blackboard
+// Facts that bots of a team would otherwise find out one by one, shared by all bots.
+//
+// Remarks:
+//   Occupied waypoints and heard sounds are rebuilt once per frame after <WorldState> by a parallel
+//   job, they must not be read before the act phase. Sightings are published by bots and radio
+//   messages during the frame and kept until round end.
+//
+class Blackboard
+{
+    //
+    // Group: Waypoints.
+    //
+public:
+
+    //
+    // Variable: occupants
+    // Bit of every player that stands on or near the waypoint, index is waypoint index.
+    //
+    vector <uint32_t> occupants;
+
+    //
+    // Group: Sounds.
+    //
+public:
+
+    //
+    // Variable: soundNum
+    // Number of sounds that can be heard this frame.
+    //
+    int soundNum;
+
+    //
+    // Variable: soundEnt
+    // Player that made the sound.
+    //
+    edict_t* soundEnt[32];
+
+    //
+    // Variable: soundOrigin
+    // Position of the sound.
+    //
+    Vector soundOrigin[32];
+
+    //
+    // Variable: soundDistance
+    // Distance the sound can be heard from.
+    //
+    float soundDistance[32];
+
+    //
+    // Group: Sightings.
+    //
+public:
+
+    //
+    // Variable: seenTime
+    // Time the enemy player was seen by the team last time, index is team and client index - 1.
+    //
+    float seenTime[TEAM_COUNT][32];
+
+    //
+    // Variable: seenOrigin
+    // Position the enemy player was seen at last time.
+    //
+    Vector seenOrigin[TEAM_COUNT][32];
+
+    //
+    // Group: Functions.
+    //
+public:
+
+    //
+    // Function: Blackboard
+    //
+    // Default blackboard constructor.
+    //
+    Blackboard(void);
+
+    //
+    // Function: Update
+    //
+    // Rebuilds the per frame facts, must be called from engine thread after <WorldState::Update>.
+    //
+    void Update(void);
+
+    //
+    // Function: Reset
+    //
+    // Forgets all sightings, called on round start.
+    //
+    void Reset(void);
+
+    //
+    // Function: AddSighting
+    //
+    // Tells the team where the enemy was seen.
+    //
+    // Parameters:
+    //   team - Team that has seen the enemy.
+    //   enemy - Seen enemy, only players are remembered.
+    //
+    void AddSighting(int team, edict_t* enemy);
+
+    //
+    // Function: GetLastSighting
+    //
+    // Gets the latest sighting of an alive enemy by the team.
+    //
+    // Parameters:
+    //   team - Team to check.
+    //   maxAge - Sightings older than this are ignored.
+    //   origin - Receives the position the enemy was seen at.
+    //
+    // Returns:
+    //   True if the team has seen an enemy recently, false otherwise.
+    //
+    bool GetLastSighting(int team, float maxAge, Vector& origin) const;
+
+    //
+    // Function: IsOccupied
+    //
+    // Checks if any player other than ignored one is on or near the waypoint.
+    //
+    // Parameters:
+    //   index - Waypoint index.
+    //   ignore - Client index - 1 of player to ignore, -1 for none.
+    //
+    // Returns:
+    //   True if waypoint is occupied, false otherwise.
+    //
+    inline bool IsOccupied(int index, int ignore) const
+    {
+        if (index < 0 || index >= static_cast <int> (occupants.size()))
+            return false;
+
+        return (occupants[index] & ~(ignore >= 0 && ignore < 32 ? 1u << ignore : 0u)) != 0;
+    }
+};
+
+extern Blackboard g_blackboard;
+
+
+#endif // WORLD_INCLUDED
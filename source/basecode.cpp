@@ -210,6 +210,7 @@ bool Bot::IsEnemyViewable(edict_t* entity, bool setEnemy, bool checkOnly)
 		m_backCheckEnemyTime = 0.0f;
 		m_seeEnemyTime = Engine::GetReference()->GetTime();
 
+		g_blackboard.AddSighting(m_team, entity);
 		SetLastEnemy(entity);
 		return true;
 	}
@@ -1186,6 +1187,10 @@ void Bot::RadioMessage(int message)
 
 	m_radioSelect = message;
 
+	// teammates learn where the enemy is even if they don't react on the radio
+	if (message == Radio_EnemySpotted && !FNullEnt(m_lastEnemy))
+		g_blackboard.AddSighting(m_team, m_lastEnemy);
+
 	if (ebot_use_radio.GetInt() != 1)
 	{
 		PlayChatterMessage(GetEqualChatter(message));
@@ -3116,7 +3121,9 @@ void Bot::CheckRadioCommands(void)
 		{
 			RadioMessage(Radio_Affirmative);
 
-			m_position = GetEntityOrigin(m_radioEntity);
+			// go to the spotted enemy, or to the teammate if nobody knows where it is
+			if (!g_blackboard.GetLastSighting(m_team, 3.0f, m_position))
+				m_position = GetEntityOrigin(m_radioEntity);
 
 			DeleteSearchNodes();
 			PushTask(TASK_MOVETOPOSITION, TASKPRI_MOVETOPOSITION, -1, 1.0f, true);
@@ -3768,7 +3775,7 @@ void Bot::ChooseAimDirection(void)
 			m_lookAt = m_lastEnemyOrigin;
 		else
 		{
-			int dangerIndex = g_exp.GetDangerIndex(m_team, m_currentWaypointIndex, m_currentWaypointIndex);
+			int dangerIndex = g_exp.GetDangerIndex(m_currentWaypointIndex, m_currentWaypointIndex, m_team);
 			if (IsValidWaypoint(dangerIndex) && IsVisible(g_waypoint->GetPath(dangerIndex)->origin, GetEntity()))
 			{
 				if ((g_waypoint->GetPath(dangerIndex)->origin - pev->origin).GetLength2D() <= 256.0f)
@@ -3817,7 +3824,7 @@ void Bot::ChooseAimDirection(void)
 				m_lookAt = m_lastEnemyOrigin;
 			else
 			{
-				int dangerIndex = g_exp.GetDangerIndex(m_team, m_currentWaypointIndex, m_currentWaypointIndex);
+				int dangerIndex = g_exp.GetDangerIndex(m_currentWaypointIndex, m_currentWaypointIndex, m_team);
 				if (IsValidWaypoint(dangerIndex) && IsVisible(g_waypoint->GetPath(dangerIndex)->origin, GetEntity()))
 				{
 					if ((g_waypoint->GetPath(dangerIndex)->origin - pev->origin).GetLength2D() <= 256.0f)
@@ -4067,18 +4074,14 @@ void Bot::CalculatePing(void)
 	int averagePing = 0;
 	int numHumans = 0;
 
-	for (int i = 0; i < Engine::GetReference()->GetMaxClients(); i++)
+	for (int i = 0; i < g_world.maxClients; i++)
 	{
-		edict_t* ent = INDEXENT(i+1);
-
-		if (!IsValidPlayer(ent))
+		if (!(g_world.playerFlags[i] & WORLD_USED))
 			continue;
 
 		numHumans++;
 
-		int ping, loss;
-		PLAYER_CNX_STATS(ent, &ping, &loss);
-
+		int ping = g_world.playerPing[i];
 		if (ping <= 0 || ping > 150)
 			ping = Engine::GetReference()->RandomInt(5, 50);
 
@@ -6949,7 +6952,7 @@ int Bot::GetAmmo(void)
 	return m_ammo[g_weaponDefs[m_currentWeapon].ammo1];
 }
 
-void Bot::TakeDamage(edict_t* inflictor, int /*damage*/, int /*armor*/, int bits)
+void Bot::TakeDamage(edict_t* inflictor, int damage, int /*armor*/, int bits)
 {
 	if (FNullEnt(inflictor) || inflictor == GetEntity())
 		return;
@@ -6966,6 +6969,8 @@ void Bot::TakeDamage(edict_t* inflictor, int /*damage*/, int /*armor*/, int bits
 	if (GetTeam(inflictor) == m_team)
 		return;
 
+	g_threatMap->AddThreat(m_currentWaypointIndex, m_team, static_cast <float> (damage));
+
 	if (!IsZombieMode() && m_currentWeapon == WEAPON_KNIFE)
 		SelectBestWeapon();
 
@@ -7403,26 +7408,22 @@ void Bot::ReactOnSound(void)
 		return;
 
 	edict_t* player = nullptr;
-	// loop through all enemy clients to check for hearable stuff
-	for (const auto& client : g_clients)
+	// loop through the sounds of this frame to check for hearable stuff
+	for (int i = 0; i < g_blackboard.soundNum; i++)
 	{
-		if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || client.ent == GetEntity())
+		if (g_blackboard.soundEnt[i] == GetEntity())
 			continue;
 
-		if (client.ent->v.flags & FL_DUCKING)
-			continue;
+		float distance = (g_blackboard.soundOrigin[i] - pev->origin).GetLength();
 
-		float distance = (client.soundPosition - pev->origin).GetLength();
-		float hearingDistance = client.hearingDistance;
-
-		if (distance > hearingDistance || hearingDistance >= 2048.0f || distance > m_maxhearrange)
+		if (distance > g_blackboard.soundDistance[i] || distance > m_maxhearrange)
 			continue;
 		
 		// focus to nearest sound.
 		float maxdist = 999999.0f;
 		if (distance < maxdist)
 		{
-			player = client.ent;
+			player = g_blackboard.soundEnt[i];
 			maxdist = distance;
 		}
 	}
@@ -7441,6 +7442,8 @@ void Bot::ReactOnSound(void)
 
 		if (m_team != GetTeam(player) || GetGameMode() == MODE_DM)
 		{
+			g_threatMap->AddThreat(GetEntityWaypoint(player), m_team, Const_ThreatSound);
+
 			// didn't bot already have an enemy ? take this one...
 			if (m_lastEnemyOrigin == nullvec || m_lastEnemy == nullptr)
 				SetLastEnemy(player);
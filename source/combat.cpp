@@ -36,12 +36,12 @@ int Bot::GetNearbyFriendsNearPosition(Vector origin, int radius)
 		return 0;
 
 	int count = 0;
-	for (const auto& client : g_clients)
+	for (int i = 0; i < g_world.maxClients; i++)
 	{
-		if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || client.team != m_team || client.ent == GetEntity())
+		if (!g_world.IsAlivePlayer(i) || g_world.playerTeam[i] != m_team || g_world.playerEnt[i] == GetEntity())
 			continue;
 
-		if ((client.origin - origin).GetLength() <= radius)
+		if ((g_world.playerOrigin[i] - origin).GetLength() <= radius)
 			count++;
 	}
 
@@ -51,12 +51,12 @@ int Bot::GetNearbyFriendsNearPosition(Vector origin, int radius)
 int Bot::GetNearbyEnemiesNearPosition(Vector origin, int radius)
 {
 	int count = 0;
-	for (const auto& client : g_clients)
+	for (int i = 0; i < g_world.maxClients; i++)
 	{
-		if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || client.team == m_team)
+		if (!g_world.IsAlivePlayer(i) || g_world.playerTeam[i] == m_team)
 			continue;
 
-		if ((client.origin - origin).GetLength() <= radius)
+		if ((g_world.playerOrigin[i] - origin).GetLength() <= radius)
 			count++;
 	}
 
@@ -77,10 +77,10 @@ void Bot::ResetCheckEnemy()
 		m_checkEnemyDistance[i] = 9999.9f;
 	}
 
-	for (i = 1; i <= Engine::GetReference()->GetMaxClients(); i++)
+	for (i = 0; i < g_world.maxClients; i++)
 	{
-		entity = INDEXENT(i);
-		if (!IsAlive(entity) || GetTeam(entity) == m_team || GetEntity() == entity)
+		entity = g_world.playerEnt[i];
+		if (!g_world.IsAlivePlayer(i) || g_world.playerTeam[i] == m_team || GetEntity() == entity)
 			continue;
 
 		m_allEnemy[m_checkEnemyNum] = entity;
@@ -90,12 +90,10 @@ void Bot::ResetCheckEnemy()
 
 	for (i = 0; i < entityNum; i++)
 	{
-		if (g_entityId[i] == -1 || g_entityAction[i] != 1 || m_team == g_entityTeam[i])
+		if (!(g_world.entityFlags[i] & WORLD_ALIVE) || g_world.entityFlags[i] & WORLD_HIDDEN || g_world.entityAction[i] != 1 || m_team == g_world.entityTeam[i])
 			continue;
 
-		entity = INDEXENT(g_entityId[i]);
-		if (FNullEnt(entity) || !IsAlive(entity) || entity->v.effects & EF_NODRAW || entity->v.takedamage == DAMAGE_NO)
-			continue;
+		entity = g_world.entityEnt[i];
 
 		m_allEnemy[m_checkEnemyNum] = entity;
 		m_allEnemyDistance[m_checkEnemyNum] = GetEntityDistance(entity);
@@ -367,7 +365,7 @@ bool Bot::LookupEnemy(void)
 				while (srcIndex != destIndex && movePoint <= 3 && srcIndex >= 0 && destIndex >= 0)
 				{
 					path = g_waypoint->GetPath(srcIndex);
-					srcIndex = *(g_waypoint->m_pathMatrix + (srcIndex * g_numWaypoints) + destIndex);
+					srcIndex = g_waypoint->GetNextHop(srcIndex, destIndex);
 					if (srcIndex < 0)
 						continue;
 
@@ -48,6 +48,7 @@ ConVar ebot_stay_max("ebot_stay_max", "3600"); // 1 hours
 BotControl::BotControl(void)
 {
 	m_lastWinner = -1;
+	m_pathExpansions = 0;
 
 	m_economicsGood[TEAM_TERRORIST] = true;
 	m_economicsGood[TEAM_COUNTER] = true;
@@ -308,53 +309,91 @@ void BotControl::DoJoinQuitStuff(void)
 	m_randomJoinTime = AddTime(RANDOM_FLOAT(min, max));
 }
 
-void ThreadedThink(int i)
+void BotControl::Think(void)
 {
-	g_botManager->GetBot(i)->Think();
-}
+	// bots are updated in two phases, Wait () runs all parallel jobs first:
+	// plan - pending path searches of all bots run on the worker threads, they only read the world
+	// act - the bot think runs after them on this thread in submission order. seeing enemies, choosing
+	// goals and aiming trace lines and use the random generator of the engine, so they stay here.
+	// searches requested while acting are run by the next pass of Wait (), path is ready in this frame.
 
-void ThreadedFacePosition(int i)
-{
-	g_botManager->GetBot(i)->FacePosition();
-}
+	// all bots read players and entities from this snapshot during the frame
+	g_world.Update();
 
-void ThreadedJoinQuit(void)
-{
-	g_botManager->DoJoinQuitStuff();
-}
+	// blackboard only reads the snapshot and waypoints, path searches don't use it, so it's built beside them
+	g_jobs->Push("Blackboard", [] { g_blackboard.Update(); }, JOB_PARALLEL);
 
-void BotControl::Think(void)
-{
-	async(launch::async, ThreadedJoinQuit);
+	// build the node costs needed by pending path searches first
+	int numSearches = 0;
+	for (int i = 0; i < Engine::GetReference()->GetMaxClients(); i++)
+	{
+		if (m_bots[i] != nullptr && m_bots[i]->m_pathRequestDest != -1)
+		{
+			g_pathCost->Request(m_bots[i]->m_pathRequestProfile, m_bots[i]->m_team, m_bots[i]->m_isZombieBot);
+			numSearches++;
+		}
+	}
+
+	g_pathCost->Update();
+
+	// split the A* budget of this frame between the searches, unfinished ones continue next frame
+	extern ConVar ebot_path_budget;
+	int maxExpansions = 0;
+
+	if (ebot_path_budget.GetInt() > 0)
+	{
+		maxExpansions = ebot_path_budget.GetInt() / (numSearches > 0 ? numSearches : 1);
+		if (maxExpansions < 1)
+			maxExpansions = 1;
+	}
+
+	// searches requested in the act phase get same share
+	m_pathExpansions = maxExpansions;
+
+	g_jobs->Push("JoinQuit", [this] { DoJoinQuitStuff(); });
 
 	extern ConVar ebot_stopbots;
 	for (int i = 0; i < Engine::GetReference()->GetMaxClients(); i++)
 	{
-		if (m_bots[i] == nullptr)
+		Bot* bot = m_bots[i];
+		if (bot == nullptr)
 			continue;
 
+		if (bot->m_pathRequestDest != -1 && !bot->m_planQueued)
+		{
+			bot->m_planQueued = true;
+			g_jobs->Push("BotPlanThink", [bot, maxExpansions] { bot->PlanThink(maxExpansions); }, JOB_PARALLEL);
+		}
+
+		g_jobs->Push("BotCheckPathRetry", [bot] { bot->CheckPathRetry(); });
+
 		bool runThink = false;
 
-		if (m_bots[i]->m_thinkTimer <= Engine::GetReference()->GetTime())
+		if (bot->m_thinkTimer <= Engine::GetReference()->GetTime())
 		{
-			if (m_bots[i]->m_lastThinkTime <= Engine::GetReference()->GetTime())
+			if (bot->m_lastThinkTime <= Engine::GetReference()->GetTime())
 				runThink = true;
 		}
 
 		if (runThink)
 		{
-			m_bots[i]->m_thinkTimer = AddTime(Engine::GetReference()->RandomFloat(0.9f, 1.1f) / 20.0f);
-			async(launch::async, ThreadedThink, i);
+			bot->m_thinkTimer = AddTime(Engine::GetReference()->RandomFloat(0.9f, 1.1f) / 20.0f);
+			g_jobs->Push("BotThink", [bot] { bot->Think(); });
 		}
-		else if (!ebot_stopbots.GetBool() && m_bots[i]->m_notKilled)
-			async(launch::async, ThreadedFacePosition, i);
+		else if (!ebot_stopbots.GetBool() && bot->m_notKilled)
+			g_jobs->Push("BotFacePosition", [bot] { bot->FacePosition(); });
 
-		m_bots[i]->m_moveAnglesForRunMove = m_bots[i]->m_moveAngles;
-		m_bots[i]->m_moveSpeedForRunMove = m_bots[i]->m_moveSpeed;
-		m_bots[i]->m_strafeSpeedForRunMove = m_bots[i]->m_strafeSpeed;
+		g_jobs->Push("BotRunMovement", [bot]
+		{
+			bot->m_moveAnglesForRunMove = bot->m_moveAngles;
+			bot->m_moveSpeedForRunMove = bot->m_moveSpeed;
+			bot->m_strafeSpeedForRunMove = bot->m_strafeSpeed;
 
-		m_bots[i]->RunPlayerMovement(); // run the player movement 
+			bot->RunPlayerMovement(); // run the player movement 
+		});
 	}
+
+	g_jobs->Wait();
 }
 
 // this function putting bot creation process to queue to prevent engine crashes
@@ -1059,6 +1098,7 @@ Bot::~Bot(void)
 {
 	// SwitchChatterIcon (false); // crash on CTRL+C'ing win32 console hlds
 	DeleteSearchNodes();
+	DeleteSearchState();
 	ResetTasks();
 
 	char botName[64];
@@ -24,25 +24,105 @@
 
 #include <core.h>
 
+ConVar ebot_save_experience("ebot_save_experience", "1");
+
+BotExperience::ExpData* BotExperience::GetData(int start, int goal)
+{
+    if (start == goal)
+        return &m_data[start];
+
+    return AddToRow(m_pairs[start], goal);
+}
+
+BotExperience::ExpData* BotExperience::AddToRow(vector <ExpPair>& row, int goal)
+{
+    // keep the row sorted, pairs are added rarely compared to reading them
+    int pos = 0;
+    while (pos < static_cast <int> (row.size()) && row[pos].goal < goal)
+        pos++;
+
+    if (pos < static_cast <int> (row.size()) && row[pos].goal == goal)
+        return &row[pos].data;
+
+    ExpPair pair;
+    pair.goal = goal;
+
+    for (int t = 0; t < TEAM_COUNT; t++)
+    {
+        pair.data.danger[t] = -1;
+        pair.data.damage[t] = 0;
+        pair.data.value[t] = 0;
+    }
+
+    row.insert(row.begin() + pos, pair);
+    return &row[pos].data;
+}
+
 void BotExperience::SetDamage(int start, int goal, int newValue, int team)
 {
     // get the pointer to experience data for faster access
-    ExpData* data = (m_data + (start * g_numWaypoints) + goal);
+    ExpData* data = GetData(start, goal);
 
     // ensure we are in ranges
     Assert(data != nullptr && (team == TEAM_COUNTER || team == TEAM_TERRORIST));
 
-    data->damage[team] = static_cast <uint16_t> (newValue); // set the data
+    uint16_t damage = static_cast <uint16_t> (newValue);
 
     // ensure data in valid range
-    if (data->damage[team] > MAX_EXPERIENCE_VALUE)
-        data->damage[team] = MAX_EXPERIENCE_VALUE;
+    if (damage > MAX_EXPERIENCE_VALUE)
+        damage = MAX_EXPERIENCE_VALUE;
+
+    // damage of waypoint with itself is stored unscaled, rounded up so reading it back gives the same value
+    if (start == goal)
+    {
+        data->damage[team] = static_cast <uint16_t> (damage / m_damageScale[team] + 0.5f); // set the data
+        return;
+    }
+
+    int oldDamage = data->damage[team];
+    data->damage[team] = damage; // set the data
+
+    UpdateRowMax(start, goal, oldDamage, team);
+}
+
+void BotExperience::UpdateRowMax(int start, int goal, int oldDamage, int team)
+{
+    ExpRowMax& rowMax = m_rowMax[start];
+    int damage = GetDamage(start, goal, team);
+
+    if (damage > 0 && (damage > rowMax.damage[team] || (damage == rowMax.damage[team] && goal < rowMax.index[team])))
+    {
+        rowMax.damage[team] = static_cast <uint16_t> (damage);
+        rowMax.index[team] = static_cast <int16> (goal);
+        return;
+    }
+
+    // the most damaging pair got less damage, another pair of the row may be higher now
+    if (goal == rowMax.index[team] && damage < oldDamage)
+        RebuildRowMax(start, team);
+}
+
+void BotExperience::RebuildRowMax(int start, int team)
+{
+    ExpRowMax& rowMax = m_rowMax[start];
+
+    rowMax.damage[team] = 0;
+    rowMax.index[team] = -1;
+
+    for (const auto& pair : m_pairs[start])
+    {
+        if (pair.data.damage[team] > rowMax.damage[team])
+        {
+            rowMax.damage[team] = pair.data.damage[team];
+            rowMax.index[team] = static_cast <int16> (pair.goal);
+        }
+    }
 }
 
 void BotExperience::SetValue(int start, int goal, int newValue, int team)
 {
     // get the pointer to experience data for faster access
-    ExpData* data = (m_data + (start * g_numWaypoints) + goal);
+    ExpData* data = GetData(start, goal);
 
     // ensure we are in ranges
     Assert(data != nullptr && (team == TEAM_COUNTER || team == TEAM_TERRORIST));
@@ -59,7 +139,7 @@ void BotExperience::SetValue(int start, int goal, int newValue, int team)
 void BotExperience::SetDangerIndex(int start, int goal, int newIndex, int team)
 {
     // get the pointer to experience data for faster access
-    ExpData* data = (m_data + (start * g_numWaypoints) + goal);
+    ExpData* data = GetData(start, goal);
 
     // ensure we are in ranges
     Assert(data != nullptr && (team == TEAM_COUNTER || team == TEAM_TERRORIST));
@@ -75,41 +155,16 @@ void BotExperience::UpdateGlobalKnowledge(void)
 
     bool recalculate = false; // do we need to recalculate if we overflowed
 
-    // iterate through both teams
+    // most damaging pairs are kept up to date while damage is collected, so just publish them
     for (int t = 0; t < TEAM_COUNT; t++)
     {
-        int index = -1; // best index
-
-        // find the most dangerous waypoint
         for (int i = 0; i < g_numWaypoints; i++)
         {
-            float max = 0;
-
-            // update the experience index
-            for (int j = 0; j < g_numWaypoints; j++)
-            {
-                if (i == j)
-                    continue; // skip self
-
-                float act = GetDamage(i, j, t); // get the damager for current point
-
-                // update the best index if we got higher damage
-                if (act > max)
-                {
-
-                    File f("exp.txt", "wt");
-                    f.Print("data recorded: i=%d,j=%d,max=%.2f,act=%.2f\n", i, j, max, act);
-
-                    max = act;
-                    index = j;
-                }
-            }
-
             // recalculate overflowed stuff
-            if (max > MAX_EXPERIENCE_VALUE)
+            if (m_rowMax[i].damage[t] > MAX_EXPERIENCE_VALUE)
                 recalculate = true;
 
-            SetDangerIndex(i, i, index, t);
+            SetDangerIndex(i, i, m_rowMax[i].index[t], t);
         }
     }
 
@@ -118,8 +173,20 @@ void BotExperience::UpdateGlobalKnowledge(void)
     {
         for (int t = 0; t < TEAM_COUNT; t++)
         {
-            for (int i = 0; i < g_numWaypoints; i++)
-                SetDamage(i, i, static_cast <int> (GetDamage(i, i, t) / (Engine::GetReference()->GetMaxClients() * 0.5f)), t);
+            // only the scale is changed, waypoint damage is decayed when it's read
+            m_damageScale[t] /= Engine::GetReference()->GetMaxClients() * 0.5f;
+
+            // stored damage must still fit into 16 bits and read damage must stay in range, apply the scale then
+            if (m_damageScale[t] > 1.0f || m_damageScale[t] * 65535.0f < MAX_EXPERIENCE_VALUE)
+            {
+                for (int i = 0; i < g_numWaypoints; i++)
+                {
+                    int damage = static_cast <int> (m_data[i].damage[t] * m_damageScale[t]);
+                    m_data[i].damage[t] = static_cast <uint16_t> (damage > MAX_EXPERIENCE_VALUE ? MAX_EXPERIENCE_VALUE : damage);
+                }
+
+                m_damageScale[t] = 1.0f;
+            }
         }
         m_history = 1;
     }
@@ -131,19 +198,19 @@ void BotExperience::UpdateGlobalKnowledge(void)
     {
         for (int i = 0; i < g_numWaypoints; i++)
         {
-            for (int j = 0; j < g_numWaypoints; j++)
+            for (auto& pair : m_pairs[i])
             {
-                if (i == j)
-                    continue; // skip self
+                int oldDamage = pair.data.damage[t];
 
                  // get the clip
-                int clip = static_cast <int> (GetDamage(i, j, t) - MAX_EXPERIENCE_VALUE * 0.5f);
+                int clip = static_cast <int> (oldDamage - MAX_EXPERIENCE_VALUE * 0.5f);
 
                 // we cannot have negative values
                 if (clip < 0)
                     clip = 0;
 
-                SetDamage(i, j, clip, t);
+                pair.data.damage[t] = static_cast <uint16_t> (clip);
+                UpdateRowMax(i, pair.goal, oldDamage, t);
             }
         }
     }
@@ -200,38 +267,341 @@ void BotExperience::CollectValue(int start, int goal, int health, float goalValu
 
 void BotExperience::Load(void)
 {
-    if (m_data != nullptr)
-        delete[] m_data;
-
-    m_data = nullptr;
+    m_data.clear();
+    m_pairs.clear();
+    m_base.data.clear();
+    m_base.pairs.clear();
+    m_savePending = false;
 
     if (g_numWaypoints < 1)
         return;
 
-    m_data = new ExpData[g_numWaypoints * g_numWaypoints];
+    ExpData empty;
+
+    // initialize table by hand to correct values, and NOT zero it out
+    for (int t = 0; t < TEAM_COUNT; t++)
+    {
+        empty.danger[t] = -1;
+        empty.damage[t] = 0;
+        empty.value[t] = 0;
+    }
+
+    ExpRowMax noDamage;
+
+    for (int t = 0; t < TEAM_COUNT; t++)
+    {
+        noDamage.damage[t] = 0;
+        noDamage.index[t] = -1;
+
+        m_damageScale[t] = 1.0f;
+    }
+
+    // only the waypoints themselves are stored densely, pairs are added when they get any data
+    m_data.assign(g_numWaypoints, empty);
+    m_pairs.resize(g_numWaypoints);
+    m_rowMax.assign(g_numWaypoints, noDamage);
 
-    if (m_data == nullptr)
+    m_fileName = FormatBuffer("%sdata/%s.exp", GetWaypointDir(), GetMapName());
+    m_graphHash = g_waypoint->GetGraphHash();
+
+    // file is read in background, it may still be written by the save of the last map
+    String fileName = m_fileName;
+    uint32_t graphHash = m_graphHash;
+    int numWaypoints = g_numWaypoints;
+    shared_future <void> previous = m_saveTask;
+
+    m_loadTask = async(launch::async, [fileName, graphHash, numWaypoints, previous]() -> shared_ptr <ExpSnapshot>
+    {
+        if (previous.valid())
+            previous.wait();
+
+        auto snapshot = make_shared <ExpSnapshot>();
+        if (!ReadFile(fileName, graphHash, numWaypoints, *snapshot))
+            return nullptr;
+
+        return snapshot;
+    });
+}
+
+void BotExperience::Unload(void)
+{
+    // save collected experience before it's gone, so the file can't be left for later
+    if (m_loadTask.valid())
+    {
+        m_loadTask.wait();
+        AdoptLoaded();
+    }
+
+    Save();
+
+    m_data.clear();
+    m_data.shrink_to_fit();
+
+    m_pairs.clear();
+    m_pairs.shrink_to_fit();
+    m_rowMax.clear();
+    m_rowMax.shrink_to_fit();
+}
+
+void BotExperience::Save(void)
+{
+    if (!ebot_save_experience.GetBool() || m_data.empty() || g_waypointsChanged)
         return;
 
-    // initialize table by hand to correct values, and NOT zero it out
+    // file must be merged first, or its experience would be counted twice. don't wait for it, Think saves later
+    if (m_loadTask.valid())
+    {
+        m_savePending = true;
+        return;
+    }
+
+    m_savePending = false;
+
+    auto current = make_shared <ExpSnapshot>();
+    TakeSnapshot(*current);
+
+    // file will have everything we know after this save
+    auto base = make_shared <ExpSnapshot>();
+    base->data.swap(m_base.data);
+    base->pairs.swap(m_base.pairs);
+    m_base = *current;
+
+    String fileName = m_fileName;
+    String tempName = FormatBuffer("%s.%d", static_cast <const char*> (m_fileName), Engine::GetReference()->RandomInt(0, 99999));
+    uint32_t graphHash = m_graphHash;
+    int numWaypoints = static_cast <int> (m_data.size());
+    shared_future <void> previous = m_saveTask;
+
+    m_saveTask = async(launch::async, [fileName, tempName, graphHash, numWaypoints, previous, current, base]
+    {
+        if (previous.valid())
+            previous.wait();
+
+        // other servers may have written the file since it was loaded, add only what we learned
+        ExpSnapshot disk;
+        if (ReadFile(fileName, graphHash, numWaypoints, disk))
+        {
+            Merge(disk, *current, *base);
+
+            if (!WriteFile(tempName, graphHash, disk))
+                return;
+        }
+        else if (!WriteFile(tempName, graphHash, *current))
+            return;
+
+        if (rename(tempName, fileName) != 0)
+        {
+            remove(fileName);
+            rename(tempName, fileName);
+        }
+    }).share();
+}
+
+void BotExperience::Think(void)
+{
+    if (!m_loadTask.valid() || m_loadTask.wait_for(chrono::seconds(0)) != future_status::ready)
+        return;
+
+    AdoptLoaded();
+
+    if (m_savePending)
+        Save();
+}
+
+void BotExperience::Flush(void)
+{
+    if (m_loadTask.valid())
+        m_loadTask.wait();
+
+    if (m_saveTask.valid())
+        m_saveTask.wait();
+}
+
+void BotExperience::TakeSnapshot(ExpSnapshot& snapshot)
+{
+    snapshot.data = m_data;
+    snapshot.pairs = m_pairs;
+
+    for (int i = 0; i < static_cast <int> (snapshot.data.size()); i++)
+    {
+        for (int t = 0; t < TEAM_COUNT; t++)
+            snapshot.data[i].damage[t] = GetDamage(i, i, t);
+    }
+}
+
+void BotExperience::AdoptLoaded(void)
+{
+    shared_ptr <ExpSnapshot> loaded = m_loadTask.get();
+
+    if (loaded == nullptr || loaded->data.size() != m_data.size() || g_waypointsChanged)
+        return;
+
+    m_base = *loaded;
+
+    // experience collected while the file was read is added on top of it
+    ExpSnapshot current;
+    TakeSnapshot(current);
+    Merge(*loaded, current, ExpSnapshot());
+
+    m_data.swap(loaded->data);
+    m_pairs.swap(loaded->pairs);
+
     for (int t = 0; t < TEAM_COUNT; t++)
     {
-        for (int i = 0; i < g_numWaypoints; i++)
-            for (int j = 0; j < g_numWaypoints; j++)
+        m_damageScale[t] = 1.0f;
+
+        for (int i = 0; i < static_cast <int> (m_data.size()); i++)
+        {
+            RebuildRowMax(i, t);
+            m_data[i].danger[t] = m_rowMax[i].index[t];
+        }
+    }
+}
+
+void BotExperience::Merge(ExpSnapshot& target, const ExpSnapshot& current, const ExpSnapshot& base)
+{
+    auto addDamage = [](uint16_t& target, int delta)
+    {
+        int damage = target + delta;
+        target = static_cast <uint16_t> (damage < 0 ? 0 : (damage > MAX_EXPERIENCE_VALUE ? MAX_EXPERIENCE_VALUE : damage));
+    };
+
+    auto addValue = [](int16& target, int delta)
+    {
+        int value = target + delta;
+        target = static_cast <int16> (value < -MAX_EXPERIENCE_VALUE ? -MAX_EXPERIENCE_VALUE : (value > MAX_EXPERIENCE_VALUE ? MAX_EXPERIENCE_VALUE : value));
+    };
+
+    for (int i = 0; i < static_cast <int> (target.data.size()); i++)
+    {
+        for (int t = 0; t < TEAM_COUNT; t++)
+        {
+            addDamage(target.data[i].damage[t], current.data[i].damage[t] - (base.data.empty() ? 0 : base.data[i].damage[t]));
+            addValue(target.data[i].value[t], current.data[i].value[t] - (base.data.empty() ? 0 : base.data[i].value[t]));
+        }
+
+        for (const auto& pair : current.pairs[i])
+        {
+            const ExpData* old = base.pairs.empty() ? nullptr : FindInRow(base.pairs[i], pair.goal);
+            ExpData* data = AddToRow(target.pairs[i], pair.goal);
+
+            for (int t = 0; t < TEAM_COUNT; t++)
             {
-                (m_data + (i * g_numWaypoints) + j)->danger[t] = -1;
-                (m_data + (i * g_numWaypoints) + j)->damage[t] = 0;
-                (m_data + (i * g_numWaypoints) + j)->value[t] = 0;
+                addDamage(data->damage[t], pair.data.damage[t] - (old != nullptr ? old->damage[t] : 0));
+                addValue(data->value[t], pair.data.value[t] - (old != nullptr ? old->value[t] : 0));
             }
+        }
     }
 }
 
-void BotExperience::Unload(void)
+bool BotExperience::ReadFile(const String& fileName, uint32_t graphHash, int numWaypoints, ExpSnapshot& snapshot)
 {
-    if (m_data != nullptr)
-        delete[] m_data;
+    File fp(fileName, "rb");
+
+    if (!fp.IsValid())
+        return false;
+
+    ExperienceHeader header;
+
+    if (!fp.Read(&header, sizeof(header)) || strncmp(header.header, FH_EXPERIENCE, sizeof(header.header)) != 0 || header.fileVersion != FV_EXPERIENCE)
+        return false;
+
+    // rows aren't limited, so every waypoint may have a pair with all the others
+    int64_t minSize = static_cast <int64_t> (numWaypoints) * (sizeof(ExpData) + sizeof(int32_t));
+    int64_t maxSize = minSize + static_cast <int64_t> (numWaypoints) * (numWaypoints - 1) * sizeof(ExpPair);
+
+    // every flag byte with its eight references of two bytes decodes to eight matches of F bytes at most
+    int64_t packedSize = fp.GetSize() - static_cast <int> (sizeof(header));
+    int64_t maxDecoded = (packedSize + 16) / 17 * 8 * F;
+
+    if (header.pointNumber != numWaypoints || header.graphHash != graphHash || header.rawSize < minSize || header.rawSize > maxSize || header.rawSize > maxDecoded)
+        return false;
+
+    vector <uint8_t> buffer(header.rawSize);
+    Compressor compressor;
+
+    if (compressor.DecodeStream(fp, fp.GetSize() - static_cast <int> (sizeof(header)), buffer.data(), header.rawSize) != header.rawSize || HashBytes(2166136261u, buffer.data(), header.rawSize) != header.dataHash)
+        return false;
+
+    // waypoints with themselves first, then every row as number of pairs and the pairs
+    const uint8_t* read = buffer.data();
+    const uint8_t* end = read + header.rawSize;
+
+    snapshot.data.resize(numWaypoints);
+    snapshot.pairs.assign(numWaypoints, vector <ExpPair>());
+
+    memcpy(snapshot.data.data(), read, numWaypoints * sizeof(ExpData));
+    read += numWaypoints * sizeof(ExpData);
+
+    for (int i = 0; i < numWaypoints; i++)
+    {
+        int32_t count;
+
+        if (end - read < static_cast <int> (sizeof(count)))
+            return false;
+
+        memcpy(&count, read, sizeof(count));
+        read += sizeof(count);
+
+        if (count < 0 || end - read < static_cast <int> (count * sizeof(ExpPair)))
+            return false;
+
+        snapshot.pairs[i].resize(count);
+        memcpy(snapshot.pairs[i].data(), read, count * sizeof(ExpPair));
+        read += count * sizeof(ExpPair);
+
+        // rows must be sorted and stay inside the waypoints
+        for (int j = 0; j < count; j++)
+        {
+            int goal = snapshot.pairs[i][j].goal;
+
+            if (goal < 0 || goal >= numWaypoints || goal == i || (j > 0 && goal <= snapshot.pairs[i][j - 1].goal))
+                return false;
+        }
+    }
+
+    return read == end;
+}
+
+bool BotExperience::WriteFile(const String& fileName, uint32_t graphHash, const ExpSnapshot& snapshot)
+{
+    int numWaypoints = static_cast <int> (snapshot.data.size());
+    vector <uint8_t> buffer(numWaypoints * sizeof(ExpData));
+
+    memcpy(buffer.data(), snapshot.data.data(), numWaypoints * sizeof(ExpData));
+
+    for (int i = 0; i < numWaypoints; i++)
+    {
+        int32_t count = static_cast <int32_t> (snapshot.pairs[i].size());
+        size_t pos = buffer.size();
+
+        buffer.resize(pos + sizeof(count) + count * sizeof(ExpPair));
+        memcpy(&buffer[pos], &count, sizeof(count));
+
+        if (count > 0)
+            memcpy(&buffer[pos + sizeof(count)], snapshot.pairs[i].data(), count * sizeof(ExpPair));
+    }
+
+    ExperienceHeader header;
+    memset(&header, 0, sizeof(header));
+
+    strcpy(header.header, FH_EXPERIENCE);
+    header.fileVersion = FV_EXPERIENCE;
+    header.pointNumber = numWaypoints;
+    header.graphHash = graphHash;
+    header.rawSize = static_cast <int32_t> (buffer.size());
+    header.dataHash = HashBytes(2166136261u, buffer.data(), header.rawSize);
+
+    File fp(fileName, "wb");
+
+    if (!fp.IsValid() || !fp.Write(&header, sizeof(header)))
+        return false;
+
+    Compressor compressor;
+    bool written = compressor.EncodeStream(fp, buffer.data(), header.rawSize) >= 0;
 
-    m_data = nullptr;
+    fp.Close();
+    return written;
 }
 
 void BotExperience::DrawText(int index, char storage[4096], int& length)
@@ -113,6 +113,8 @@ edict_t* g_worldEdict = nullptr;
 edict_t* g_hostEntity = nullptr;
 globalvars_t* g_pGlobals = nullptr;
 
+mutex g_traceLock; // engine traces can be fired from worker threads in the plan phase
+
 // default tables for personality weapon preferences, overridden by weapons.cfg
 int g_normalWeaponPrefs[Const_NumWeapons] =
 { 0, 2, 1, 4, 5, 6, 3, 12, 10, 24, 25, 13, 11, 8, 7, 22, 23, 18, 21, 17, 19, 15, 17, 9, 14, 16 };
@@ -221,6 +221,8 @@ int BotCommandHandler_O(edict_t* ent, const String& arg0, const String& arg1, co
 		ClientPrint(ent, print_console, "ebot weaponmode         - select e-bot weapon mode");
 		ClientPrint(ent, print_console, "ebot votemap            - allows dead e-bots to vote for specific map");
 		ClientPrint(ent, print_console, "ebot cmenu              - displaying e-bots command menu");
+		ClientPrint(ent, print_console, "ebot jobs               - display job system timings (jobs reset - clear them)");
+		ClientPrint(ent, print_console, "ebot pathcache          - display path cache hit rate (pathcache clear - empty it)");
 
 
 		ClientPrint(ent, print_console, "ebot_add                - create a e-bot in current game");
@@ -349,6 +351,38 @@ int BotCommandHandler_O(edict_t* ent, const String& arg0, const String& arg1, co
 			for (int i = 0; i < 500; i++)
 				ServerPrintNoTag("Result Range[0 - 100]: %d", Engine::GetReference()->RandomInt(0, 100));
 		}
+
+		// measure path search cost
+		else if (stricmp(arg1, "pathbench") == 0)
+			BenchmarkPathfinding(ent, atoi(arg2));
+
+		// compare A* heuristics on random paths
+		else if (stricmp(arg1, "heuristicbench") == 0)
+			BenchmarkHeuristics(ent, atoi(arg2));
+	}
+
+	// show or reset job system timings
+	else if (stricmp(arg0, "jobs") == 0)
+	{
+		if (stricmp(arg1, "reset") == 0)
+		{
+			g_jobs->ResetStats();
+			ClientPrint(ent, print_console, "Job timings cleared");
+		}
+		else
+			g_jobs->PrintStats(ent);
+	}
+
+	// show or clear shared path cache
+	else if (stricmp(arg0, "pathcache") == 0)
+	{
+		if (stricmp(arg1, "clear") == 0)
+		{
+			g_pathCache->Clear();
+			ClientPrint(ent, print_console, "Path cache cleared");
+		}
+		else
+			g_pathCache->PrintStats(ent);
 	}
 
 	// waypoint manimupulation (really obsolete, can be edited through menu) (supported only on listen server)
@@ -639,7 +673,7 @@ int BotCommandHandler_O(edict_t* ent, const String& arg0, const String& arg1, co
 		// write experience table (and visibility table) to hard disk
 		if (stricmp(arg1, "save") == 0)
 		{
-			g_exp.Unload();
+			g_exp.Save();
 
 			ServerPrint("Experience tab saved");
 		}
@@ -2597,6 +2631,9 @@ void ServerActivate(edict_t* pentEdictList, int edictCount, int clientMax)
 
 	async(launch::async, InitConfig); // initialize all config files
 
+	// waypoint loading may build the path matrix on the worker threads
+	g_jobs->Initialize();
+
 	// do level initialization stuff here...
 	g_waypoint->Initialize();
 	g_exp.Unload();
@@ -2617,8 +2654,6 @@ void ServerActivate(edict_t* pentEdictList, int edictCount, int clientMax)
 		RETURN_META(MRES_IGNORED);
 
 	(*g_functionTable.pfnServerActivate) (pentEdictList, edictCount, clientMax);
-
-	g_waypoint->InitializeVisibility();
 }
 
 void ServerDeactivate(void)
@@ -2633,10 +2668,14 @@ void ServerDeactivate(void)
 	// any case, when the new map will be booting, ServerActivate() will be called, so we'll do
 	// the loading of new bots and the new BSP data parsing there.
 
-	// save collected experience on shutdown
+	// save collected experience on shutdown, server may be gone before the next map is loaded
 	g_exp.Unload();
+	g_exp.Flush();
 	g_waypoint->Destroy();
 	g_botManager->Destroy();
+
+	// library may be unloaded after this, worker threads are started again with the next frame
+	g_jobs->Destroy();
 	// TODO free global data
 
 	if (g_isMetamod)
@@ -2796,7 +2835,7 @@ void UpdateClientData(const struct edict_s* ent, int sendweapons, struct clientd
 {
 	extern ConVar ebot_ping;
 	if (ebot_ping.GetBool())
-		async(launch::async, SetPing, const_cast <edict_t*> (ent));
+		SetPing(const_cast <edict_t*> (ent));
 
 	if (g_isMetamod)
 		RETURN_META(MRES_IGNORED);
@@ -2881,9 +2920,24 @@ void ThreadedBombposition(void)
 static float secondTimer = 0.0;
 void FrameThread(void)
 {
+	// start the worker threads here, ebot_threads is set by the config after the game dll is initialized
+	g_jobs->Initialize();
+
 	if (g_analyzewaypoints)
 		g_waypoint->Analyze();
 
+	// visibility table is traced over several frames after map load
+	g_waypoint->ThinkVisibility();
+
+	// repack the waypoint links edited last frame, searches read them without locks
+	g_waypoint->UpdateLinks();
+
+	// experience file is read in background, take it when it's ready
+	g_exp.Think();
+
+	// fade out the threat of old fights
+	g_threatMap->Think();
+
 	if (ebot_lockzbot.GetBool())
 	{
 		if (CVAR_GET_FLOAT("bot_quota") > 0)
@@ -2898,8 +2952,8 @@ void FrameThread(void)
 
 	if (secondTimer < Engine::GetReference()->GetTime())
 	{
-		async(launch::async, LoadEntityData);
-		async(launch::async, JustAStuff);
+		g_jobs->Push("LoadEntityData", LoadEntityData);
+		g_jobs->Push("JustAStuff", JustAStuff);
 
 		float time = 2.0f;
 		if (g_waypointOn)
@@ -2909,10 +2963,12 @@ void FrameThread(void)
 	}
 
 	if (g_bombPlanted)
-		async(launch::async, ThreadedBombposition);
+		g_jobs->Push("BombPosition", ThreadedBombposition);
 
 	// keep bot number up to date
-	async(launch::async, ThreadedMaintain);
+	g_jobs->Push("MaintainQuota", ThreadedMaintain);
+
+	g_jobs->Wait();
 }
 
 void StartFrame(void)
@@ -2925,7 +2981,7 @@ void StartFrame(void)
 	// for example if a new player joins the server, we should disconnect a bot, and if the
 	// player population decreases, we should fill the server with other bots.
 
-	async(launch::async, FrameThread);
+	FrameThread();
 
 	if (g_isMetamod)
 		RETURN_META(MRES_IGNORED);
@@ -2933,11 +2989,6 @@ void StartFrame(void)
 	(*g_functionTable.pfnStartFrame) ();
 }
 
-void ThreadedThink(void)
-{
-	g_botManager->Think();
-}
-
 void StartFrame_Post(void)
 {
 	// this function starts a video frame. It is called once per video frame by the engine. If
@@ -2947,7 +2998,7 @@ void StartFrame_Post(void)
 	// for the bots by the MOD side, remember).  Post version called only by metamod.
 
 	// **** AI EXECUTION STARTS ****
-	async(launch::async, ThreadedThink);
+	g_botManager->Think();
 	// **** AI EXECUTION FINISH ****
 
 	RETURN_META(MRES_IGNORED);
@@ -2968,11 +3019,6 @@ int Spawn_Post(edict_t* ent)
 	RETURN_META_VALUE(MRES_IGNORED, 0);
 }
 
-void ThreadedVis(void)
-{
-	g_waypoint->InitializeVisibility();
-}
-
 void ServerActivate_Post(edict_t* /*pentEdictList*/, int /*edictCount*/, int /*clientMax*/)
 {
 	// this function is called when the server has fully loaded and is about to manifest itself
@@ -2983,8 +3029,6 @@ void ServerActivate_Post(edict_t* /*pentEdictList*/, int /*edictCount*/, int /*c
 	// Once this function has been called, the server can be considered as "running". Post version
 	// called only by metamod.
 
-	async(launch::async, ThreadedVis);
-
 	RETURN_META(MRES_IGNORED);
 }
 
@@ -3047,7 +3091,7 @@ void pfnEmitSound(edict_t* entity, int channel, const char* sample, float volume
 	// SoundAttachToThreat() to bring the sound to the ears of the bots. Since bots have no client DLL
 	// to handle this for them, such a job has to be done manually.
 
-	async(launch::async, SoundAttachToThreat, entity, sample, volume);
+	SoundAttachToThreat(entity, sample, volume);
 
 	if (g_isMetamod)
 		RETURN_META(MRES_IGNORED);
@@ -3726,6 +3770,11 @@ export int Meta_Detach(PLUG_LOADTIME now, PL_UNLOAD_REASON reason)
 	}
 	g_botManager->RemoveAll(); // kick all bots off this server
 
+	// don't let the experience save thread outlive the plugin
+	g_exp.Flush();
+
+	g_jobs->Destroy(); // stop the worker threads
+
 	return true;
 }
 
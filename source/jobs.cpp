@@ -0,0 +1,244 @@
+//
+// Copyright (c) 2003-2009, by Yet Another POD-Bot Development Team.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// $Id:$
+//
+
+#include <core.h>
+
+ConVar ebot_threads("ebot_threads", "-1"); // -1 = number of cores minus one
+
+JobSystem::JobSystem(void)
+{
+	m_nextParallelJob = 0;
+	m_runningJobs = 0;
+	m_shutdown = false;
+	m_engineJobsRunning = false;
+}
+
+JobSystem::~JobSystem(void)
+{
+	// static objects are destroyed while the library is unloaded, joining threads there deadlocks on
+	// windows loader lock. the threads are stopped by Destroy () on server shutdown or plugin detach.
+	for (auto& worker : m_workers)
+	{
+		if (worker.joinable())
+			worker.detach();
+	}
+}
+
+void JobSystem::Initialize(void)
+{
+	// this function creates the worker threads, they will sleep until some parallel job is pushed.
+	// it's called every frame, so the threads are recreated when ebot_threads is changed
+
+	int numWorkers = ebot_threads.GetInt();
+	if (numWorkers < 0)
+		numWorkers = static_cast <int> (thread::hardware_concurrency()) - 1;
+
+	if (numWorkers > 32)
+		numWorkers = 32;
+
+	if (numWorkers == static_cast <int> (m_workers.size()))
+		return;
+
+	Destroy();
+
+	m_shutdown = false;
+
+	for (int i = 0; i < numWorkers; i++)
+		m_workers.push_back(thread(&JobSystem::WorkerThread, this));
+}
+
+void JobSystem::Destroy(void)
+{
+	// this function finishes all queued jobs and stops the worker threads
+
+	Wait();
+
+	{
+		lock_guard <mutex> lock(m_queueLock);
+		m_shutdown = true;
+	}
+
+	m_wakeUp.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+
+	m_workers.clear();
+}
+
+void JobSystem::Push(const char* name, function <void(void)> func, JobType type)
+{
+	// this function queues a job, nothing is executed until Wait () is called for engine jobs
+
+	Job job;
+	job.name = name;
+	job.func = func;
+
+	// parallel jobs may push engine jobs too
+	{
+		lock_guard <mutex> lock(m_queueLock);
+
+		if (type == JOB_ENGINE)
+		{
+			m_engineJobs.push_back(job);
+			return;
+		}
+
+		m_parallelJobs.push_back(job);
+	}
+
+	m_wakeUp.notify_one();
+}
+
+void JobSystem::Wait(void)
+{
+	// this function is the frame barrier. first all parallel jobs are finished (the calling thread
+	// helps the workers), then the engine jobs are executed on the calling thread in submission order.
+	// both kinds of jobs may push new jobs, so it loops until both queues are empty.
+
+	for (;;)
+	{
+		while (RunParallelJob());
+
+		vector <Job> jobs;
+
+		{
+			unique_lock <mutex> lock(m_queueLock);
+			m_jobsDone.wait(lock, [this] { return !HasParallelJob() && m_runningJobs == 0; });
+
+			m_parallelJobs.clear();
+			m_nextParallelJob = 0;
+
+			// parallel queue is empty here, no engine job means nothing is left to do
+			jobs.swap(m_engineJobs);
+			m_engineJobsRunning = !jobs.empty();
+		}
+
+		if (jobs.empty())
+			break;
+
+		// parallel jobs pushed by these run in the next pass, never next to an engine job
+		for (const auto& job : jobs)
+			Execute(job);
+
+		{
+			lock_guard <mutex> lock(m_queueLock);
+			m_engineJobsRunning = false;
+		}
+
+		m_wakeUp.notify_all();
+	}
+}
+
+bool JobSystem::RunParallelJob(bool worker)
+{
+	Job job;
+
+	{
+		lock_guard <mutex> lock(m_queueLock);
+
+		if (!HasParallelJob() || (worker && m_engineJobsRunning))
+			return false;
+
+		job = m_parallelJobs[m_nextParallelJob++];
+		m_runningJobs++;
+	}
+
+	Execute(job);
+
+	{
+		lock_guard <mutex> lock(m_queueLock);
+		m_runningJobs--;
+	}
+
+	m_jobsDone.notify_all();
+	return true;
+}
+
+void JobSystem::WorkerThread(void)
+{
+	for (;;)
+	{
+		{
+			unique_lock <mutex> lock(m_queueLock);
+			m_wakeUp.wait(lock, [this] { return m_shutdown || (HasParallelJob() && !m_engineJobsRunning); });
+
+			if (m_shutdown && !HasParallelJob())
+				return;
+		}
+
+		RunParallelJob(true);
+	}
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	auto start = chrono::high_resolution_clock::now();
+	job.func();
+	double elapsed = chrono::duration <double, micro>(chrono::high_resolution_clock::now() - start).count();
+
+	lock_guard <mutex> lock(m_statsLock);
+
+	for (auto& stats : m_stats)
+	{
+		if (stats.name != job.name && strcmp(stats.name, job.name) != 0)
+			continue;
+
+		stats.calls++;
+		stats.totalTime += elapsed;
+
+		if (stats.maxTime < elapsed)
+			stats.maxTime = elapsed;
+
+		return;
+	}
+
+	JobStats stats;
+	stats.name = job.name;
+	stats.calls = 1;
+	stats.totalTime = elapsed;
+	stats.maxTime = elapsed;
+
+	m_stats.push_back(stats);
+}
+
+void JobSystem::PrintStats(edict_t* ent)
+{
+	lock_guard <mutex> lock(m_statsLock);
+
+	ClientPrint(ent, print_console, "Job system: %d worker thread(s)", GetWorkersNum());
+	ClientPrint(ent, print_console, "%-24s %10s %12s %12s", "Job", "Calls", "Avg (us)", "Max (us)");
+
+	for (const auto& stats : m_stats)
+		ClientPrint(ent, print_console, "%-24s %10d %12.2f %12.2f", stats.name, stats.calls, stats.totalTime / stats.calls, stats.maxTime);
+}
+
+void JobSystem::ResetStats(void)
+{
+	lock_guard <mutex> lock(m_statsLock);
+	m_stats.clear();
+}
@@ -28,6 +28,10 @@ ConVar ebot_aimbot("ebot_aimbot", "0");
 ConVar ebot_aim_boost_in_zm("ebot_zm_aim_boost", "1");
 ConVar ebot_zombies_as_path_cost("ebot_zombie_count_as_path_cost", "1");
 ConVar ebot_ping_affects_aim("ebot_ping_affects_aim", "1");
+ConVar ebot_path_cost_update("ebot_path_cost_update", "0.25"); // seconds between path cost table rebuilds
+ConVar ebot_path_budget("ebot_path_budget", "4096"); // A* node expansions per frame shared by all bots, 0 = no limit
+ConVar ebot_path_clusters("ebot_path_clusters", "1"); // plan long paths over waypoint clusters
+ConVar ebot_threat_halflife("ebot_threat_halflife", "10"); // seconds until waypoint threat drops to half
 
 extern ConVar ebot_anti_block;
 
@@ -445,8 +449,12 @@ bool Bot::GoalIsValid(void)
 		return false;
 	else if (goal == m_currentWaypointIndex) // no nodes needed
 		return true;
+	else if (m_pathRequestDest == goal) // search for it is still running, bot walks the partial path meanwhile
+		return true;
 	else if (m_navNode == nullptr) // no path calculated
 		return false;
+	else if (m_pathGoalIndex == goal) // path ends at a cluster entrance on the way, next part is searched there
+		return true;
 
 	// got path - check if still valid
 	PathNode* node = m_navNode;
@@ -698,6 +706,7 @@ public:
 
 	inline int  Empty(void) { return m_size == 0; }
 	inline int  Size(void) { return m_size; }
+	inline void Clear(void) { m_size = 0; }
 	void        Insert(int, float);
 	int         Remove(void);
 
@@ -718,14 +727,14 @@ private:
 PriorityQueue::PriorityQueue(void)
 {
 	m_size = 0;
-	m_heapSize = Const_MaxWaypoints * 4;
-	m_heap = new HeapNode_t[m_heapSize];
+	m_heapSize = 256; // grows with the searches, big maps don't cost anything on small ones
+	m_heap = (HeapNode_t*)malloc(sizeof(HeapNode_t) * m_heapSize);
 }
 
 PriorityQueue::~PriorityQueue(void)
 {
 	if (m_heap != nullptr)
-		delete[] m_heap;
+		free(m_heap);
 
 	m_heap = nullptr;
 }
@@ -735,7 +744,7 @@ void PriorityQueue::Insert(int value, float priority)
 {
 	if (m_size >= m_heapSize)
 	{
-		m_heapSize += 100;
+		m_heapSize *= 2;
 		m_heap = (HeapNode_t*)realloc(m_heap, sizeof(HeapNode_t) * m_heapSize);
 
 		if (m_heap == nullptr)
@@ -809,11 +818,152 @@ void PriorityQueue::HeapSiftUp(void)
 	}
 }
 
-float GF_AllInOne(int index, int parent, int team, float gravity, bool isZombie)
+// reusable A* search state, every thread owns one so searches don't need any lock
+class SearchWorkspace
+{
+public:
+	// the search being run, it's continued in the next frame when the expansion budget runs out
+	int srcIndex;
+	int destIndex;
+	int requestIndex; // goal asked by the bot, differs from destIndex when only path to next cluster is searched
+	int profile;
+	int team;
+	float gravity;
+	bool isZombie;
+	PathHeuristicFunc hcalc;
+
+	bool running;
+	int expansions; // nodes expanded since the search started
+	int numWaypoints; // waypoints were reloaded if this doesn't match
+	int bestIndex; // closed node nearest to the goal, used for partial path
+	float bestHeuristic;
+	float heuristicScale; // landmark bound is scaled to cost units, other heuristics are used as they are
+	uint32_t epoch; // costs the search was started with
+	uint32_t threat; // threat generation the search was started with
+
+	SearchWorkspace(void)
+	{
+		m_generation = 0;
+
+		running = false;
+	}
+
+	inline bool IsRunning(int dest, int costProfile, PathHeuristicFunc heuristic, int searchTeam, float searchGravity, bool zombie)
+	{
+		return running && numWaypoints == g_numWaypoints && requestIndex == dest && profile == costProfile && hcalc == heuristic && team == searchTeam && gravity == searchGravity && isZombie == zombie;
+	}
+
+	// starts a new search, nodes are reset lazily on first access so this is O(1)
+	void Reset(bool fullReset = false)
+	{
+		m_openList.Clear();
+
+		// new nodes get the zero stamp, so they are reset on first access too
+		if (static_cast <int> (m_nodes.size()) < g_numWaypoints)
+		{
+			m_nodes.resize(g_numWaypoints);
+			m_stamps.resize(g_numWaypoints, 0);
+		}
+
+		if (++m_generation == 0)
+		{
+			m_stamps.assign(m_stamps.size(), 0);
+			m_generation = 1;
+		}
+
+		// old behaviour, only used for benchmarking
+		if (fullReset)
+		{
+			for (int i = 0; i < g_numWaypoints; i++)
+				GetNode(i);
+		}
+	}
+
+	inline AStar_t* GetNode(int index)
+	{
+		AStar_t* node = &m_nodes[index];
+
+		if (m_stamps[index] != m_generation)
+		{
+			m_stamps[index] = m_generation;
+
+			node->g = 0;
+			node->f = 0;
+			node->parent = -1;
+			node->state = State::New;
+		}
+
+		return node;
+	}
+
+	inline PriorityQueue& GetOpenList(void) { return m_openList; }
+
+private:
+	vector <AStar_t> m_nodes;
+	vector <uint32_t> m_stamps;
+	uint32_t m_generation;
+	PriorityQueue m_openList;
+};
+
+static SearchWorkspace& GetSearchWorkspace(void)
+{
+	static thread_local SearchWorkspace workspace;
+	return workspace;
+}
+
+// workspaces of bot searches, a bot holds one only while its search is split over frames
+static mutex s_workspaceLock;
+static vector <unique_ptr <SearchWorkspace> > s_freeWorkspaces;
+
+static SearchWorkspace* AcquireWorkspace(void)
+{
+	lock_guard <mutex> lock(s_workspaceLock);
+
+	if (s_freeWorkspaces.empty())
+		return new SearchWorkspace;
+
+	SearchWorkspace* workspace = s_freeWorkspaces.back().release();
+	s_freeWorkspaces.pop_back();
+
+	return workspace;
+}
+
+static void ReleaseWorkspace(SearchWorkspace* workspace)
+{
+	workspace->running = false;
+
+	lock_guard <mutex> lock(s_workspaceLock);
+	s_freeWorkspaces.push_back(unique_ptr <SearchWorkspace>(workspace));
+}
+
+// this function checks the costs that depend on the bot gravity and on the parent, they can't be cached
+inline bool GF_IsBlocked(int index, int parent, float gravity, const uint8_t* fallBlocked)
 {
 	Path* path = g_waypoint->GetPath(index);
 	if (path->flags & WAYPOINT_SPECIFICGRAVITY && (gravity * (1600 - 800)) < path->campStartY)
-		return 65355.0f;
+		return true;
+
+	if (parent == -1)
+		return false;
+
+	Path* parentPath = g_waypoint->GetPath(parent);
+	if (parentPath->flags & WAYPOINT_FALLCHECK)
+	{
+		if (fallBlocked != nullptr)
+			return fallBlocked[parent] != 0;
+
+		TraceResult tr;
+		TraceLine(parentPath->origin, parentPath->origin - Vector(0.0f, 0.0f, 60.0f), false, false, g_hostEntity, &tr);
+		if (tr.flFraction == 1.0f)
+			return true;
+	}
+
+	return false;
+}
+
+float GF_AllInOne(int index, int team, bool isZombie)
+{
+	Path* path = g_waypoint->GetPath(index);
 
 	if (isZombie)
 	{
@@ -829,24 +979,15 @@ float GF_AllInOne(int index, int parent, int team, float gravity, bool isZombie)
 			return 65355.0f;
 	}
 
-	Path* parentPath = g_waypoint->GetPath(parent);
-	if (parentPath->flags & WAYPOINT_FALLCHECK)
-	{
-		TraceResult tr;
-		TraceLine(parentPath->origin, parentPath->origin - Vector(0.0f, 0.0f, 60.0f), false, false, g_hostEntity, &tr);
-		if (tr.flFraction == 1.0f)
-			return 65355.0f;
-	}
-
 	float cost = 0.0f;
 	if (path->flags & WAYPOINT_ONLYONE)
 	{
-		for (const auto& client : g_clients)
+		for (int i = 0; i < g_world.maxClients; i++)
 		{
-			if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || team != GetTeam(client.ent))
+			if (!g_world.IsAlivePlayer(i) || team != g_world.playerTeam[i])
 				continue;
 
-			float distance = (client.origin - path->origin).GetLengthSquared();
+			float distance = (g_world.playerOrigin[i] - path->origin).GetLengthSquared();
 			if (distance <= path->radius + (64.0f * 64.0f))
 			{
 				cost = 65355.0f;
@@ -864,11 +1005,11 @@ float GF_AllInOne(int index, int parent, int team, float gravity, bool isZombie)
 	return 0.0f;
 }
 
-inline const float GF_CostHuman(int index, int parent, int team, float gravity, bool isZombie)
+inline const float GF_CostHuman(int index, int team, bool isZombie)
 {
 	Path* path = g_waypoint->GetPath(index);
 
-	float baseCost = GF_AllInOne(index, parent, team, gravity, isZombie);
+	float baseCost = GF_AllInOne(index, team, isZombie);
 	if (baseCost > 0.0f)
 		return baseCost;
 
@@ -877,12 +1018,12 @@ inline const float GF_CostHuman(int index, int parent, int team, float gravity,
 	int count = 0;
 	float totalDistance = 0.0f;
 	const Vector waypointOrigin = path->origin;
-	for (const auto& client : g_clients)
+	for (int i = 0; i < g_world.maxClients; i++)
 	{
-		if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || !IsZombieEntity(client.ent))
+		if (!g_world.IsAlivePlayer(i) || !(g_world.playerFlags[i] & WORLD_ZOMBIE))
 			continue;
 
-		float distance = ((client.origin + client.ent->v.velocity * g_pGlobals->frametime) - waypointOrigin).GetLengthSquared2D();
+		float distance = ((g_world.playerOrigin[i] + g_world.playerVelocity[i] * g_pGlobals->frametime) - waypointOrigin).GetLengthSquared2D();
 		if (distance <= path->radius + 128.0f)
 			count++;
 
@@ -898,11 +1039,11 @@ inline const float GF_CostHuman(int index, int parent, int team, float gravity,
 	return baseCost;
 }
 
-inline const float GF_CostCareful(int index, int parent, int team, float gravity, bool isZombie)
+inline const float GF_CostCareful(int index, int team, bool isZombie)
 {
 	Path* path = g_waypoint->GetPath(index);
 
-	float baseCost = GF_AllInOne(index, parent, team, gravity, isZombie);
+	float baseCost = GF_AllInOne(index, team, isZombie);
 	if (baseCost > 0.0f)
 		return baseCost;
 
@@ -913,14 +1054,14 @@ inline const float GF_CostCareful(int index, int parent, int team, float gravity
 		if (path->flags & WAYPOINT_DJUMP)
 		{
 			int count = 0;
-			for (const auto& client : g_clients)
+			for (int i = 0; i < g_world.maxClients; i++)
 			{
-				if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || client.team != team)
+				if (!g_world.IsAlivePlayer(i) || g_world.playerTeam[i] != team)
 					continue;
 
-				if ((client.origin - path->origin).GetLength() <= 512.0f + path->radius)
+				if ((g_world.playerOrigin[i] - path->origin).GetLength() <= 512.0f + path->radius)
 					count++;
-				else if (IsVisible(path->origin, client.ent))
+				else if (IsVisible(path->origin, g_world.playerEnt[i]))
 					count++;
 			}
 
@@ -942,11 +1083,11 @@ inline const float GF_CostCareful(int index, int parent, int team, float gravity
 	return baseCost;
 }
 
-inline const float GF_CostNormal(int index, int parent, int team, float gravity, bool isZombie)
+inline const float GF_CostNormal(int index, int team, bool isZombie)
 {
 	Path* path = g_waypoint->GetPath(index);
 
-	float baseCost = GF_AllInOne(index, parent, team, gravity, isZombie);
+	float baseCost = GF_AllInOne(index, team, isZombie);
 	if (baseCost > 0.0f)
 		return baseCost;
 
@@ -957,14 +1098,14 @@ inline const float GF_CostNormal(int index, int parent, int team, float gravity,
 		if (path->flags & WAYPOINT_DJUMP)
 		{
 			int count = 0;
-			for (const auto& client : g_clients)
+			for (int i = 0; i < g_world.maxClients; i++)
 			{
-				if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || client.team != team)
+				if (!g_world.IsAlivePlayer(i) || g_world.playerTeam[i] != team)
 					continue;
 
-				if ((client.origin - path->origin).GetLength() <= 512.0f + path->radius)
+				if ((g_world.playerOrigin[i] - path->origin).GetLength() <= 512.0f + path->radius)
 					count++;
-				else if (IsVisible(path->origin, client.ent))
+				else if (IsVisible(path->origin, g_world.playerEnt[i]))
 					count++;
 			}
 
@@ -982,11 +1123,11 @@ inline const float GF_CostNormal(int index, int parent, int team, float gravity,
 	return baseCost;
 }
 
-inline const float GF_CostRusher(int index, int parent, int team, float gravity, bool isZombie)
+inline const float GF_CostRusher(int index, int team, bool isZombie)
 {
 	Path* path = g_waypoint->GetPath(index);
 
-	float baseCost = GF_AllInOne(index, parent, team, gravity, isZombie);
+	float baseCost = GF_AllInOne(index, team, isZombie);
 	if (baseCost > 0.0f)
 		return baseCost;
 
@@ -996,13 +1137,11 @@ inline const float GF_CostRusher(int index, int parent, int team, float gravity,
 	if (path->flags & WAYPOINT_DJUMP)
 		return 65355.0f;
 
-	if (path->flags & WAYPOINT_CROUCH)
-		return g_waypoint->GetPathDistanceFloat(parent, index);
-
+	// crouch waypoints cost the path distance from the parent, see PathCostTable::GetCost
 	return 0.0f;
 }
 
-inline const float GF_CostNoHostage(int index, int parent, int team, float gravity, bool isZombie)
+inline const float GF_CostNoHostage(int index, int team, bool isZombie)
 {
 	Path* path = g_waypoint->GetPath(index);
 
@@ -1033,7 +1172,7 @@ inline const float GF_CostNoHostage(int index, int parent, int team, float gravi
 	for (int i = 0; i < Const_MaxPathIndex; i++)
 	{
 		int neighbour = g_waypoint->GetPath(index)->index[i];
-		if (IsValidWaypoint(neighbour) && (path->connectionFlags[neighbour] & PATHFLAG_JUMP || path->connectionFlags[neighbour] & PATHFLAG_DOUBLE))
+		if (IsValidWaypoint(neighbour) && (path->connectionFlags[i] & PATHFLAG_JUMP || path->connectionFlags[i] & PATHFLAG_DOUBLE))
 			return 65355.0f;
 	}
 
@@ -1064,17 +1203,1027 @@ inline const float HF_Distance(int start, int goal)
 	return (sPath - gPath).GetLengthSquared2D();
 }
 
-inline const float HF_Cheby(int start, int goal)
+inline const float HF_Cheby(int start, int goal)
+{
+	auto sPath = g_waypoint->GetPath(start)->origin;
+	auto gPath = g_waypoint->GetPath(goal)->origin;
+	float x = fabsf(sPath.x - gPath.x);
+	float y = fabsf(sPath.y - gPath.y);
+	float xy = fabsf(x + y);
+	return Clamp(xy, x, y);
+}
+
+inline const float HF_Landmark(int start, int goal)
+{
+	return g_landmarks->GetBound(start, goal);
+}
+
+LandmarkTable::LandmarkTable(void)
+{
+	m_numLandmarks = 0;
+	m_numWaypoints = -1;
+}
+
+// this function computes path distances from source to every waypoint, or to source if reverse is set
+void LandmarkTable::Dijkstra(int source, bool reverse, float* dist)
+{
+	for (int i = 0; i < g_numWaypoints; i++)
+		dist[i] = FLT_MAX;
+
+	// reverse search walks the connections backwards, so collect incoming ones first
+	vector <int> incomingFirst;
+	vector <int> incoming;
+
+	if (reverse)
+	{
+		incomingFirst.assign(g_numWaypoints + 1, 0);
+
+		for (int i = 0; i < g_numWaypoints; i++)
+		{
+			Path* path = g_waypoint->GetPath(i);
+			for (int j = 0; j < Const_MaxPathIndex; j++)
+			{
+				if (IsValidWaypoint(path->index[j]))
+					incomingFirst[path->index[j] + 1]++;
+			}
+		}
+
+		for (int i = 0; i < g_numWaypoints; i++)
+			incomingFirst[i + 1] += incomingFirst[i];
+
+		incoming.resize(incomingFirst[g_numWaypoints]);
+		vector <int> fill(incomingFirst.begin(), incomingFirst.end() - 1);
+
+		for (int i = 0; i < g_numWaypoints; i++)
+		{
+			Path* path = g_waypoint->GetPath(i);
+			for (int j = 0; j < Const_MaxPathIndex; j++)
+			{
+				if (IsValidWaypoint(path->index[j]))
+					incoming[fill[path->index[j]]++] = i * Const_MaxPathIndex + j; // connection j of waypoint i
+			}
+		}
+	}
+
+	PriorityQueue openList;
+
+	dist[source] = 0.0f;
+	openList.Insert(source, 0.0f);
+
+	while (!openList.Empty())
+	{
+		int current = openList.Remove();
+
+		if (!reverse)
+		{
+			Path* path = g_waypoint->GetPath(current);
+			for (int j = 0; j < Const_MaxPathIndex; j++)
+			{
+				int next = path->index[j];
+				if (!IsValidWaypoint(next))
+					continue;
+
+				float distance = dist[current] + path->distances[j];
+				if (distance < dist[next])
+				{
+					dist[next] = distance;
+					openList.Insert(next, distance);
+				}
+			}
+
+			continue;
+		}
+
+		for (int i = incomingFirst[current]; i < incomingFirst[current + 1]; i++)
+		{
+			int prev = incoming[i] / Const_MaxPathIndex;
+
+			float distance = dist[current] + g_waypoint->GetPath(prev)->distances[incoming[i] % Const_MaxPathIndex];
+			if (distance < dist[prev])
+			{
+				dist[prev] = distance;
+				openList.Insert(prev, distance);
+			}
+		}
+	}
+}
+
+// this function picks the landmarks and computes their distances, must be called after waypoints are loaded
+void LandmarkTable::Build(void)
+{
+	m_numLandmarks = 0;
+	m_numWaypoints = g_numWaypoints;
+
+	m_distFrom.assign(Const_MaxLandmarks * g_numWaypoints, FLT_MAX);
+	m_distTo.assign(Const_MaxLandmarks * g_numWaypoints, FLT_MAX);
+
+	if (g_numWaypoints < 2)
+		return;
+
+	// landmarks far from each other give the best bounds, so every next one is the farthest from those picked
+	vector <float> nearest(g_numWaypoints, FLT_MAX);
+	vector <float> start(g_numWaypoints);
+
+	Dijkstra(0, false, &start[0]);
+
+	int landmark = 0;
+	for (int i = 1; i < g_numWaypoints; i++)
+	{
+		if (start[i] != FLT_MAX && (start[landmark] == FLT_MAX || start[i] > start[landmark]))
+			landmark = i;
+	}
+
+	while (m_numLandmarks < Const_MaxLandmarks && m_numLandmarks < g_numWaypoints)
+	{
+		float* from = &m_distFrom[m_numLandmarks * g_numWaypoints];
+		float* to = &m_distTo[m_numLandmarks * g_numWaypoints];
+
+		Dijkstra(landmark, false, from);
+		Dijkstra(landmark, true, to);
+
+		m_landmarks[m_numLandmarks++] = landmark;
+
+		int farthest = -1;
+		for (int i = 0; i < g_numWaypoints; i++)
+		{
+			if (from[i] < nearest[i])
+				nearest[i] = from[i];
+
+			if (nearest[i] == FLT_MAX || nearest[i] <= 0.0f)
+				continue;
+
+			if (farthest == -1 || nearest[i] > nearest[farthest])
+				farthest = i;
+		}
+
+		if (farthest == -1)
+			break;
+
+		landmark = farthest;
+	}
+}
+
+PathClusters::PathClusters(void)
+{
+	m_numWaypoints = -1;
+	m_numClusters = 0;
+}
+
+// this function computes path distances inside the cluster of source, from source or to source if reverse is set
+void PathClusters::SearchCluster(int source, bool reverse, vector <float>& dist)
+{
+	dist.assign(m_numWaypoints, FLT_MAX);
+
+	int cluster = m_cluster[source];
+	PriorityQueue openList;
+
+	dist[source] = 0.0f;
+	openList.Insert(source, 0.0f);
+
+	while (!openList.Empty())
+	{
+		int current = openList.Remove();
+
+		if (reverse)
+		{
+			for (int i = m_inFirst[current]; i < m_inFirst[current + 1]; i++)
+			{
+				int prev = m_inSource[i];
+				if (m_cluster[prev] != cluster)
+					continue;
+
+				float distance = dist[current] + m_inCost[i];
+				if (distance < dist[prev])
+				{
+					dist[prev] = distance;
+					openList.Insert(prev, distance);
+				}
+			}
+
+			continue;
+		}
+
+		Path* path = g_waypoint->GetPath(current);
+		for (int j = 0; j < Const_MaxPathIndex; j++)
+		{
+			int next = path->index[j];
+			if (!IsValidWaypoint(next) || m_cluster[next] != cluster)
+				continue;
+
+			float distance = dist[current] + path->distances[j];
+			if (distance < dist[next])
+			{
+				dist[next] = distance;
+				openList.Insert(next, distance);
+			}
+		}
+	}
+}
+
+// this function splits the waypoints into clusters and connects their entrances, must be called after waypoints are loaded
+void PathClusters::Build(void)
+{
+	m_numWaypoints = g_numWaypoints;
+	m_numClusters = 0;
+
+	m_entrances.clear();
+	m_edgeFirst.clear();
+	m_edgeTarget.clear();
+	m_edgeCost.clear();
+
+	// clusters are cells of fixed size, waypoints in same cell belong together
+	vector <int> cellX, cellY, cellZ;
+	m_cluster.resize(g_numWaypoints);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		const Vector& origin = g_waypoint->GetPath(i)->origin;
+
+		int x = static_cast <int> (floorf(origin.x / Const_ClusterSize));
+		int y = static_cast <int> (floorf(origin.y / Const_ClusterSize));
+		int z = static_cast <int> (floorf(origin.z / Const_ClusterHeight));
+
+		m_cluster[i] = -1;
+		for (int cluster = 0; cluster < m_numClusters; cluster++)
+		{
+			if (cellX[cluster] == x && cellY[cluster] == y && cellZ[cluster] == z)
+			{
+				m_cluster[i] = cluster;
+				break;
+			}
+		}
+
+		if (m_cluster[i] != -1)
+			continue;
+
+		cellX.push_back(x);
+		cellY.push_back(y);
+		cellZ.push_back(z);
+
+		m_cluster[i] = m_numClusters++;
+	}
+
+	// incoming connections, needed for searching towards a goal
+	m_inFirst.assign(g_numWaypoints + 1, 0);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		Path* path = g_waypoint->GetPath(i);
+		for (int j = 0; j < Const_MaxPathIndex; j++)
+		{
+			if (IsValidWaypoint(path->index[j]))
+				m_inFirst[path->index[j] + 1]++;
+		}
+	}
+
+	for (int i = 0; i < g_numWaypoints; i++)
+		m_inFirst[i + 1] += m_inFirst[i];
+
+	m_inSource.resize(m_inFirst[g_numWaypoints]);
+	m_inCost.resize(m_inFirst[g_numWaypoints]);
+
+	vector <int> fill(m_inFirst.begin(), m_inFirst.end() - 1);
+
+	// waypoints connected with other cluster are the entrances
+	m_abstractIndex.assign(g_numWaypoints, -1);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		Path* path = g_waypoint->GetPath(i);
+		for (int j = 0; j < Const_MaxPathIndex; j++)
+		{
+			int next = path->index[j];
+			if (!IsValidWaypoint(next))
+				continue;
+
+			m_inSource[fill[next]] = i;
+			m_inCost[fill[next]++] = static_cast <float> (path->distances[j]);
+
+			if (m_cluster[next] == m_cluster[i])
+				continue;
+
+			if (m_abstractIndex[i] == -1)
+			{
+				m_abstractIndex[i] = static_cast <int> (m_entrances.size());
+				m_entrances.push_back(i);
+			}
+
+			if (m_abstractIndex[next] == -1)
+			{
+				m_abstractIndex[next] = static_cast <int> (m_entrances.size());
+				m_entrances.push_back(next);
+			}
+		}
+	}
+
+	// entrances and waypoints of every cluster
+	int numNodes = static_cast <int> (m_entrances.size());
+
+	m_clusterFirst.assign(m_numClusters + 1, 0);
+	m_entranceSlot.resize(numNodes);
+
+	for (int i = 0; i < numNodes; i++)
+		m_clusterFirst[m_cluster[m_entrances[i]] + 1]++;
+
+	for (int i = 0; i < m_numClusters; i++)
+		m_clusterFirst[i + 1] += m_clusterFirst[i];
+
+	m_clusterEntrances.resize(numNodes);
+	fill.assign(m_clusterFirst.begin(), m_clusterFirst.end() - 1);
+
+	for (int i = 0; i < numNodes; i++)
+	{
+		int cluster = m_cluster[m_entrances[i]];
+
+		m_entranceSlot[i] = fill[cluster] - m_clusterFirst[cluster];
+		m_clusterEntrances[fill[cluster]++] = i;
+	}
+
+	vector <int> waypointFirst(m_numClusters + 1, 0);
+	vector <int> waypoints(g_numWaypoints);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+		waypointFirst[m_cluster[i] + 1]++;
+
+	for (int i = 0; i < m_numClusters; i++)
+		waypointFirst[i + 1] += waypointFirst[i];
+
+	fill.assign(waypointFirst.begin(), waypointFirst.end() - 1);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+		waypoints[fill[m_cluster[i]]++] = i;
+
+	// every waypoint keeps the distances to and from the entrances of its cluster, so planning needs no search in the clusters
+	m_distFirst.resize(g_numWaypoints);
+
+	int numDistances = 0;
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		m_distFirst[i] = numDistances;
+		numDistances += m_clusterFirst[m_cluster[i] + 1] - m_clusterFirst[m_cluster[i]];
+	}
+
+	m_toEntrance.assign(numDistances, FLT_MAX);
+	m_fromEntrance.assign(numDistances, FLT_MAX);
+
+	// connect every entrance with the entrances of other clusters it leads to, and the ones of own cluster it can reach
+	vector <float> dist;
+
+	for (int node = 0; node < numNodes; node++)
+	{
+		int entrance = m_entrances[node];
+		int cluster = m_cluster[entrance];
+
+		SearchCluster(entrance, true, dist);
+
+		for (int i = waypointFirst[cluster]; i < waypointFirst[cluster + 1]; i++)
+			m_toEntrance[m_distFirst[waypoints[i]] + m_entranceSlot[node]] = dist[waypoints[i]];
+
+		m_edgeFirst.push_back(static_cast <int> (m_edgeTarget.size()));
+
+		Path* path = g_waypoint->GetPath(entrance);
+		for (int j = 0; j < Const_MaxPathIndex; j++)
+		{
+			int next = path->index[j];
+			if (!IsValidWaypoint(next) || m_cluster[next] == m_cluster[entrance])
+				continue;
+
+			m_edgeTarget.push_back(m_abstractIndex[next]);
+			m_edgeCost.push_back(static_cast <float> (path->distances[j]));
+		}
+
+		SearchCluster(entrance, false, dist);
+
+		for (int i = waypointFirst[cluster]; i < waypointFirst[cluster + 1]; i++)
+			m_fromEntrance[m_distFirst[waypoints[i]] + m_entranceSlot[node]] = dist[waypoints[i]];
+
+		for (int other : m_entrances)
+		{
+			if (other == entrance || m_cluster[other] != m_cluster[entrance] || dist[other] == FLT_MAX)
+				continue;
+
+			m_edgeTarget.push_back(m_abstractIndex[other]);
+			m_edgeCost.push_back(dist[other]);
+		}
+	}
+
+	m_edgeFirst.push_back(static_cast <int> (m_edgeTarget.size()));
+}
+
+bool PathClusters::IsValid(void) const
+{
+	return m_numClusters > 1 && m_numWaypoints == g_numWaypoints && !g_waypointsChanged;
+}
+
+// this function plans the path over the cluster entrances and returns the entrance of the next cluster on the way,
+// or the destination itself if it's in this cluster or the next one
+int PathClusters::GetNextGoal(int srcIndex, int destIndex, int& expansions)
+{
+	expansions = 0;
+
+	int srcCluster = m_cluster[srcIndex];
+	int destCluster = m_cluster[destIndex];
+
+	if (srcCluster == destCluster)
+		return destIndex;
+
+	int numNodes = static_cast <int> (m_entrances.size());
+	int goalNode = numNodes; // virtual node for the destination
+
+	// searches run on the worker threads, every thread reuses its own arrays
+	static thread_local vector <float> g;
+	static thread_local vector <int> parent;
+	static thread_local vector <bool> closed;
+	static thread_local PriorityQueue openList;
+
+	g.assign(numNodes + 1, FLT_MAX);
+	parent.assign(numNodes + 1, -1);
+	closed.assign(numNodes + 1, false);
+	openList.Clear();
+
+	const Vector& goalOrigin = g_waypoint->GetPath(destIndex)->origin;
+
+	// costs from the start to the entrances of its cluster were found when the clusters were built
+	const float* startCost = &m_toEntrance[m_distFirst[srcIndex]];
+	const float* goalCost = &m_fromEntrance[m_distFirst[destIndex]];
+
+	for (int i = m_clusterFirst[srcCluster]; i < m_clusterFirst[srcCluster + 1]; i++)
+	{
+		int node = m_clusterEntrances[i];
+		float cost = startCost[i - m_clusterFirst[srcCluster]];
+
+		if (cost == FLT_MAX)
+			continue;
+
+		g[node] = cost;
+		openList.Insert(node, cost + (g_waypoint->GetPath(m_entrances[node])->origin - goalOrigin).GetLength());
+	}
+
+	while (!openList.Empty())
+	{
+		int current = openList.Remove();
+		if (current == goalNode)
+			break;
+
+		if (closed[current])
+			continue;
+
+		closed[current] = true;
+		expansions++;
+
+		// entrance of the goal cluster, the goal itself can be reached from here
+		int waypoint = m_entrances[current];
+		if (m_cluster[waypoint] == destCluster)
+		{
+			float cost = goalCost[m_entranceSlot[current]];
+
+			if (cost != FLT_MAX && g[current] + cost < g[goalNode])
+			{
+				g[goalNode] = g[current] + cost;
+				parent[goalNode] = current;
+
+				openList.Insert(goalNode, g[goalNode]);
+			}
+		}
+
+		for (int i = m_edgeFirst[current]; i < m_edgeFirst[current + 1]; i++)
+		{
+			int next = m_edgeTarget[i];
+			float cost = g[current] + m_edgeCost[i];
+
+			if (closed[next] || cost >= g[next])
+				continue;
+
+			g[next] = cost;
+			parent[next] = current;
+
+			openList.Insert(next, cost + (g_waypoint->GetPath(m_entrances[next])->origin - goalOrigin).GetLength());
+		}
+	}
+
+	// no abstract path, let the normal search deal with it
+	if (parent[goalNode] == -1)
+		return destIndex;
+
+	// walk back to the first entrance out of the start cluster
+	int nextGoal = destIndex;
+	for (int node = parent[goalNode]; node != -1; node = parent[node])
+	{
+		int waypoint = m_entrances[node];
+		if (m_cluster[waypoint] != srcCluster)
+			nextGoal = waypoint;
+	}
+
+	if (nextGoal != destIndex && m_cluster[nextGoal] == destCluster)
+		return destIndex;
+
+	return nextGoal;
+}
+
+ThreatMap::ThreatMap(void)
+{
+	m_numWaypoints = 0;
+	m_decayTime = 0.0f;
+
+	for (int team = 0; team < TEAM_COUNT; team++)
+		m_generation[team] = 0;
+}
+
+// this function fades out the threat, must be called every frame from the engine thread
+void ThreatMap::Think(void)
+{
+	// waypoints were added or removed, keep the threat of the others
+	if (m_numWaypoints != g_numWaypoints)
+	{
+		m_numWaypoints = g_numWaypoints;
+
+		for (int team = 0; team < TEAM_COUNT; team++)
+		{
+			m_threat[team].resize((m_numWaypoints + 3) & ~3, 0.0f);
+
+			for (int i = m_numWaypoints; i < static_cast <int> (m_threat[team].size()); i++)
+				m_threat[team][i] = 0.0f;
+		}
+	}
+
+	float time = Engine::GetReference()->GetTime();
+	float delta = time - m_decayTime;
+
+	m_decayTime = time;
+
+	// time is reset on map change
+	if (delta <= 0.0f || m_numWaypoints < 1)
+		return;
+
+	float halfLife = ebot_threat_halflife.GetFloat();
+	if (halfLife < 0.1f)
+		halfLife = 0.1f;
+
+	const __m128 factor = _mm_set1_ps(powf(0.5f, delta / halfLife));
+	const __m128 cutoff = _mm_set1_ps(0.01f); // don't keep tiny values, they slow down as denormals
+	const __m128 level = _mm_set1_ps(Const_ThreatCacheLevel);
+
+	for (int team = 0; team < TEAM_COUNT; team++)
+	{
+		float* threat = m_threat[team].data();
+		int size = static_cast <int> (m_threat[team].size());
+
+		bool faded = false;
+
+		for (int i = 0; i < size; i += 4)
+		{
+			__m128 old = _mm_loadu_ps(threat + i);
+			__m128 value = _mm_mul_ps(old, factor);
+
+			if (_mm_movemask_ps(_mm_cmpge_ps(old, level)) != _mm_movemask_ps(_mm_cmpge_ps(value, level)))
+				faded = true;
+
+			_mm_storeu_ps(threat + i, _mm_and_ps(value, _mm_cmpge_ps(value, cutoff)));
+		}
+
+		if (faded)
+			m_generation[team]++;
+	}
+}
+
+void ThreatMap::Reset(void)
+{
+	for (int team = 0; team < TEAM_COUNT; team++)
+	{
+		m_threat[team].assign((m_numWaypoints + 3) & ~3, 0.0f);
+		m_generation[team]++;
+	}
+}
+
+// this function adds threat to the waypoint, the connected waypoints get the half of it
+void ThreatMap::AddThreat(int index, int team, float amount)
+{
+	if (index < 0 || index >= m_numWaypoints || team < 0 || team >= TEAM_COUNT || amount <= 0.0f)
+		return;
+
+	float* threat = m_threat[team].data();
+
+	if (threat[index] < Const_ThreatCacheLevel && threat[index] + amount >= Const_ThreatCacheLevel)
+		m_generation[team]++;
+
+	threat[index] += amount;
+	if (threat[index] > Const_ThreatMax)
+		threat[index] = Const_ThreatMax;
+
+	int numLinks;
+	const int16* links = g_waypoint->GetLinks(index, numLinks);
+
+	for (int i = 0; i < numLinks; i++)
+	{
+		int neighbour = links[i];
+		if (neighbour < 0 || neighbour >= m_numWaypoints)
+			continue;
+
+		if (threat[neighbour] < Const_ThreatCacheLevel && threat[neighbour] + amount * 0.5f >= Const_ThreatCacheLevel)
+			m_generation[team]++;
+
+		threat[neighbour] += amount * 0.5f;
+		if (threat[neighbour] > Const_ThreatMax)
+			threat[neighbour] = Const_ThreatMax;
+	}
+}
+
+bool LandmarkTable::IsValid(void) const
+{
+	return m_numLandmarks > 0 && m_numWaypoints == g_numWaypoints && !g_waypointsChanged;
+}
+
+// this function returns the lower bound of path length from start to goal by triangle inequality
+float LandmarkTable::GetBound(int start, int goal) const
+{
+	float bound = 0.0f;
+
+	for (int i = 0; i < m_numLandmarks; i++)
+	{
+		const float* from = &m_distFrom[i * m_numWaypoints];
+		const float* to = &m_distTo[i * m_numWaypoints];
+
+		// d(start, goal) >= d(landmark, goal) - d(landmark, start)
+		if (from[start] != FLT_MAX && from[goal] != FLT_MAX && from[goal] - from[start] > bound)
+			bound = from[goal] - from[start];
+
+		// d(start, goal) >= d(start, landmark) - d(goal, landmark)
+		if (to[start] != FLT_MAX && to[goal] != FLT_MAX && to[start] - to[goal] > bound)
+			bound = to[start] - to[goal];
+	}
+
+	return bound;
+}
+
+static const PathCostFunc s_costFunctions[PATHCOST_NUM] = { GF_CostHuman, GF_CostCareful, GF_CostNormal, GF_CostRusher, GF_CostNoHostage };
+
+// how much each profile avoids recent fights, careful bots keep away the most
+static const float s_threatWeight[PATHCOST_NUM] = { 1.0f, 2.0f, 1.0f, 0.0f, 0.0f };
+
+// this function returns the threat state paths of the profile depend on, profiles without threat cost ignore it
+static uint32_t GetThreatGeneration(int profile, int team)
+{
+	return s_threatWeight[profile] > 0.0f ? g_threatMap->GetGeneration(team) : 0;
+}
+
+PathCostTable::PathCostTable(void)
+{
+	memset(m_generation, 0, sizeof(m_generation));
+	memset(m_distScale, 0, sizeof(m_distScale));
+	m_fallGeneration = 0;
+
+	Reset();
+}
+
+// this function marks all tables as outdated
+void PathCostTable::Reset(void)
+{
+	for (int profile = 0; profile < PATHCOST_NUM; profile++)
+	{
+		for (int team = 0; team < TEAM_COUNT; team++)
+		{
+			for (int zombie = 0; zombie < 2; zombie++)
+			{
+				m_updateTime[profile][team][zombie] = 0.0f;
+				m_requested[profile][team][zombie] = false;
+				m_numWaypoints[profile][team][zombie] = -1;
+				m_generation[profile][team][zombie]++;
+			}
+		}
+	}
+
+	m_fallUpdateTime = 0.0f;
+	m_fallNumWaypoints = -1;
+	m_fallGeneration++;
+}
+
+// this function marks the table as needed by a path search in this frame
+void PathCostTable::Request(int profile, int team, bool isZombie)
+{
+	if (team < 0 || team >= TEAM_COUNT)
+		return;
+
+	m_requested[profile][team][isZombie ? 1 : 0] = true;
+}
+
+// this function rebuilds the requested tables that are outdated, must be called from the engine thread
+void PathCostTable::Update(void)
+{
+	bool rebuild = false;
+
+	for (int profile = 0; profile < PATHCOST_NUM; profile++)
+	{
+		for (int team = 0; team < TEAM_COUNT; team++)
+		{
+			for (int zombie = 0; zombie < 2; zombie++)
+			{
+				if (!m_requested[profile][team][zombie])
+					continue;
+
+				m_requested[profile][team][zombie] = false;
+
+				if (m_numWaypoints[profile][team][zombie] == g_numWaypoints && m_updateTime[profile][team][zombie] > Engine::GetReference()->GetTime())
+					continue;
+
+				// every table is independent, so they can be built at same time
+				g_jobs->Push("PathCostBuild", [this, profile, team, zombie] { Build(profile, team, zombie == 1); }, JOB_PARALLEL);
+				rebuild = true;
+			}
+		}
+	}
+
+	if (!rebuild)
+		return;
+
+	if (m_fallNumWaypoints != g_numWaypoints || m_fallUpdateTime <= Engine::GetReference()->GetTime())
+		BuildFallCheck();
+
+	g_jobs->Wait();
+}
+
+// this function returns the factor that makes a path length a lower bound of the path cost, 0 if it isn't known
+float PathCostTable::GetDistanceScale(int profile, int team, bool isZombie) const
+{
+	if (team < 0 || team >= TEAM_COUNT || m_numWaypoints[profile][team][isZombie ? 1 : 0] != g_numWaypoints)
+		return 0.0f;
+
+	return m_distScale[profile][team][isZombie ? 1 : 0];
+}
+
+// this function builds the table right now if it's outdated
+void PathCostTable::Prepare(int profile, int team, bool isZombie)
+{
+	Request(profile, team, isZombie);
+	Update();
+}
+
+void PathCostTable::Build(int profile, int team, bool isZombie)
+{
+	int zombie = isZombie ? 1 : 0;
+
+	vector <float>& costs = m_cost[profile][team][zombie];
+	if (static_cast <int> (costs.size()) != g_numWaypoints)
+		costs.resize(g_numWaypoints, 0.0f);
+
+	float* cost = costs.data();
+
+	// cached paths stay valid while the costs doesn't change
+	bool changed = m_numWaypoints[profile][team][zombie] != g_numWaypoints;
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		float newCost = s_costFunctions[profile](i, team, isZombie);
+		if (cost[i] == newCost)
+			continue;
+
+		cost[i] = newCost;
+		changed = true;
+	}
+
+	if (changed)
+		m_generation[profile][team][zombie]++;
+
+	// landmark bounds are path lengths, they stay below the cost only when scaled by the cheapest cost per unit
+	float scale = FLT_MAX;
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		Path* path = g_waypoint->GetPath(i);
+
+		for (int j = 0; j < Const_MaxPathIndex; j++)
+		{
+			int next = path->index[j];
+			if (next < 0 || next >= g_numWaypoints || path->distances[j] <= 0)
+				continue;
+
+			float ratio = cost[next] / path->distances[j];
+			if (ratio < scale)
+				scale = ratio;
+		}
+	}
+
+	// crouch waypoints cost the link length for rushers
+	if (profile == PATHCOST_RUSHER && scale > 1.0f)
+		scale = 1.0f;
+
+	m_distScale[profile][team][zombie] = scale == FLT_MAX || scale < 0.0f ? 0.0f : scale;
+
+	m_numWaypoints[profile][team][zombie] = g_numWaypoints;
+	m_updateTime[profile][team][zombie] = AddTime(ebot_path_cost_update.GetFloat());
+}
+
+// this function traces the ground below all fall check waypoints
+void PathCostTable::BuildFallCheck(void)
+{
+	bool changed = m_fallNumWaypoints != g_numWaypoints;
+
+	if (static_cast <int> (m_fallBlocked.size()) != g_numWaypoints)
+		m_fallBlocked.resize(g_numWaypoints, 0);
+
+	for (int i = 0; i < g_numWaypoints; i++)
+	{
+		Path* path = g_waypoint->GetPath(i);
+		bool blocked = false;
+
+		if (path->flags & WAYPOINT_FALLCHECK)
+		{
+			TraceResult tr;
+			TraceLine(path->origin, path->origin - Vector(0.0f, 0.0f, 60.0f), false, false, g_hostEntity, &tr);
+
+			blocked = tr.flFraction == 1.0f;
+		}
+
+		if (m_fallBlocked[i] == blocked)
+			continue;
+
+		m_fallBlocked[i] = blocked;
+		changed = true;
+	}
+
+	if (changed)
+		m_fallGeneration++;
+
+	m_fallNumWaypoints = g_numWaypoints;
+	m_fallUpdateTime = AddTime(ebot_path_cost_update.GetFloat());
+}
+
+// this function returns the cost of the waypoint for A*, a single table lookup in most cases
+float PathCostTable::GetCost(int profile, int index, int parent, int team, float gravity, bool isZombie)
+{
+	// no hostage profile doesn't care about gravity and parent
+	if (profile != PATHCOST_NOHOSTAGE && GF_IsBlocked(index, parent, gravity, m_fallNumWaypoints == g_numWaypoints ? m_fallBlocked.data() : nullptr))
+		return 65355.0f;
+
+	// not a real team (deathmatch), evaluate it directly
+	float cost;
+	if (team < 0 || team >= TEAM_COUNT || m_numWaypoints[profile][team][isZombie ? 1 : 0] != g_numWaypoints)
+		cost = s_costFunctions[profile](index, team, isZombie);
+	else
+		cost = m_cost[profile][team][isZombie ? 1 : 0][index];
+
+	// crouch waypoints cost the path distance from the parent for rushers
+	if (profile == PATHCOST_RUSHER && cost < 65355.0f && g_waypoint->GetPath(index)->flags & WAYPOINT_CROUCH)
+		return g_waypoint->GetPathDistanceFloat(parent, index);
+
+	// threat fades every frame, it's added here so it doesn't outdate the cost tables. cached paths are
+	// only outdated when a waypoint crosses Const_ThreatCacheLevel
+	if (cost < 65355.0f)
+		cost += g_threatMap->GetThreat(index, team) * s_threatWeight[profile];
+
+	return cost;
+}
+
+PathCache::PathCache(void)
+{
+	m_numEntries = 0;
+	m_useCounter = 0;
+	m_hits = 0;
+	m_misses = 0;
+
+	for (int i = 0; i < Const_PathCacheBuckets; i++)
+		m_buckets[i] = -1;
+}
+
+uint32_t PathCache::HashKey(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, int gravity, bool isZombie)
+{
+	int32_t key[6] = { srcIndex, destIndex, profile, team, gravity, isZombie ? 1 : 0 };
+
+	uint32_t hash = HashBytes(2166136261u, key, sizeof(key));
+	return HashBytes(hash, &hcalc, sizeof(hcalc));
+}
+
+// this function returns the entry with the same key, or -1
+int PathCache::FindEntry(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, int gravity, bool isZombie)
+{
+	const int mask = Const_PathCacheBuckets - 1;
+
+	for (int bucket = HashKey(srcIndex, destIndex, profile, hcalc, team, gravity, isZombie) & mask; m_buckets[bucket] != -1; bucket = (bucket + 1) & mask)
+	{
+		const Entry& entry = m_entries[m_buckets[bucket]];
+
+		if (entry.srcIndex == srcIndex && entry.destIndex == destIndex && entry.profile == profile && entry.heuristic == hcalc && entry.team == team && entry.gravity == gravity && entry.isZombie == isZombie)
+			return m_buckets[bucket];
+	}
+
+	return -1;
+}
+
+// this function takes the entry out of the buckets, following entries are moved back so no probe chain is cut
+void PathCache::RemoveEntry(int index)
+{
+	const int mask = Const_PathCacheBuckets - 1;
+	const Entry& entry = m_entries[index];
+
+	int hole = HashKey(entry.srcIndex, entry.destIndex, entry.profile, entry.heuristic, entry.team, entry.gravity, entry.isZombie) & mask;
+	while (m_buckets[hole] != index)
+		hole = (hole + 1) & mask;
+
+	for (int bucket = (hole + 1) & mask; m_buckets[bucket] != -1; bucket = (bucket + 1) & mask)
+	{
+		const Entry& other = m_entries[m_buckets[bucket]];
+		int home = HashKey(other.srcIndex, other.destIndex, other.profile, other.heuristic, other.team, other.gravity, other.isZombie) & mask;
+
+		// entry can fill the hole only if the hole lies between its home bucket and its bucket
+		if (((bucket - home) & mask) >= ((bucket - hole) & mask))
+		{
+			m_buckets[hole] = m_buckets[bucket];
+			hole = bucket;
+		}
+	}
+
+	m_buckets[hole] = -1;
+}
+
+// this function returns the cached path if it was found with the same costs, can be called from plan threads
+shared_ptr <const vector <int16> > PathCache::Find(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie)
+{
+	lock_guard <mutex> lock(m_lock);
+
+	int index = FindEntry(srcIndex, destIndex, profile, hcalc, team, static_cast <int> (gravity * 100.0f), isZombie);
+	if (index == -1 || m_entries[index].epoch != g_pathCost->GetEpoch(profile, team, isZombie) || m_entries[index].threat != GetThreatGeneration(profile, team))
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	m_hits++;
+	m_entries[index].lastUse = ++m_useCounter;
+
+	return m_entries[index].path;
+}
+
+// this function stores the path, least recently used entry is replaced when cache is full
+void PathCache::Insert(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie, shared_ptr <const vector <int16> > path)
+{
+	lock_guard <mutex> lock(m_lock);
+
+	int quantizedGravity = static_cast <int> (gravity * 100.0f);
+	int index = FindEntry(srcIndex, destIndex, profile, hcalc, team, quantizedGravity, isZombie);
+
+	if (index == -1)
+	{
+		if (m_numEntries < Const_PathCacheSize)
+			index = m_numEntries++;
+		else
+		{
+			index = 0;
+
+			for (int i = 1; i < m_numEntries; i++)
+			{
+				if (m_entries[i].lastUse < m_entries[index].lastUse)
+					index = i;
+			}
+
+			RemoveEntry(index);
+		}
+
+		const int mask = Const_PathCacheBuckets - 1;
+
+		int bucket = HashKey(srcIndex, destIndex, profile, hcalc, team, quantizedGravity, isZombie) & mask;
+		while (m_buckets[bucket] != -1)
+			bucket = (bucket + 1) & mask;
+
+		m_buckets[bucket] = static_cast <int16> (index);
+	}
+
+	Entry& entry = m_entries[index];
+
+	entry.srcIndex = srcIndex;
+	entry.destIndex = destIndex;
+	entry.profile = profile;
+	entry.team = team;
+	entry.gravity = quantizedGravity;
+	entry.isZombie = isZombie;
+	entry.heuristic = hcalc;
+	entry.epoch = g_pathCost->GetEpoch(profile, team, isZombie);
+	entry.threat = GetThreatGeneration(profile, team);
+	entry.lastUse = ++m_useCounter;
+	entry.path = path;
+}
+
+void PathCache::Clear(void)
+{
+	lock_guard <mutex> lock(m_lock);
+
+	for (int i = 0; i < m_numEntries; i++)
+		m_entries[i].path.reset();
+
+	for (int i = 0; i < Const_PathCacheBuckets; i++)
+		m_buckets[i] = -1;
+
+	m_numEntries = 0;
+	m_useCounter = 0;
+}
+
+void PathCache::PrintStats(edict_t* ent)
 {
-	auto sPath = g_waypoint->GetPath(start)->origin;
-	auto gPath = g_waypoint->GetPath(goal)->origin;
-	float x = fabsf(sPath.x - gPath.x);
-	float y = fabsf(sPath.y - gPath.y);
-	float xy = fabsf(x + y);
-	return Clamp(xy, x, y);
+	lock_guard <mutex> lock(m_lock);
+
+	int total = m_hits + m_misses;
+	ClientPrint(ent, print_console, "Path cache: %d/%d entries, %d hits, %d misses (%.1f%% hit rate)", m_numEntries, Const_PathCacheSize, m_hits, m_misses, total > 0 ? 100.0f * m_hits / total : 0.0f);
 }
 
-// this function finds a path from srcIndex to destIndex
+// this function requests a path from srcIndex to destIndex, the search itself runs in the plan phase
 void Bot::FindPath(int srcIndex, int destIndex)
 {
 	if (m_pathtimer + 1.0 > Engine::GetReference()->GetTime())
@@ -1106,109 +2255,217 @@ void Bot::FindPath(int srcIndex, int destIndex)
 		return;
 	}
 
-	m_chosenGoalIndex = destIndex;
-	m_goalValue = 0.0f;
-
-	for (int i = 0; i < g_numWaypoints; i++)
+	// destination can't be reached from here, take a random goal that can be instead of a failing search
+	if (!g_waypoint->IsReachable(srcIndex, destIndex))
 	{
-		waypoints[i].g = 0;
-		waypoints[i].f = 0;
-		waypoints[i].parent = -1;
-		waypoints[i].state = State::New;
+		destIndex = -1;
+
+		for (int i = 0; i < 8 && !g_waypoint->m_otherPoints.IsEmpty(); i++)
+		{
+			int index = g_waypoint->m_otherPoints.GetRandomElement();
+			if (g_waypoint->IsReachable(srcIndex, index))
+			{
+				destIndex = index;
+				break;
+			}
+		}
+
+		if (destIndex == -1)
+			return;
 	}
 
-	const float (*gcalc) (int, int, int, float, bool) = nullptr;
-	const float (*hcalc) (int, int) = nullptr;
+	m_chosenGoalIndex = destIndex;
+	m_goalValue = 0.0f;
+
+	int profile = PATHCOST_NORMAL;
+	PathHeuristicFunc hcalc = nullptr;
 
 	if (m_personality == PERSONALITY_CAREFUL)
 		hcalc = HF_Cheby;
 	else if (m_personality == PERSONALITY_RUSHER)
 		hcalc = HF_Mannhattan;
+	else if (g_landmarks->IsValid())
+		hcalc = HF_Landmark;
 	else
 		hcalc = HF_Distance;
 
 	if (IsZombieMode() && ebot_zombies_as_path_cost.GetBool() && !m_isZombieBot)
-		gcalc = GF_CostHuman;
+		profile = PATHCOST_HUMAN;
 	else if (m_isBomber || m_isVIP || (g_bombPlanted && m_inBombZone))
 	{
 		// move faster...
 		if (g_timeRoundMid <= Engine::GetReference()->GetTime())
-			gcalc = GF_CostRusher;
+			profile = PATHCOST_RUSHER;
 		else
-			gcalc = GF_CostCareful;
+			profile = PATHCOST_CAREFUL;
 	}
 	else if (g_bombPlanted && m_team == TEAM_COUNTER)
-		gcalc = GF_CostRusher;
+		profile = PATHCOST_RUSHER;
 	else if (HasHostage())
-		gcalc = GF_CostNoHostage;
+		profile = PATHCOST_NOHOSTAGE;
 	else if (m_personality == PERSONALITY_CAREFUL)
-		gcalc = GF_CostCareful;
+		profile = PATHCOST_CAREFUL;
 	else if (m_personality == PERSONALITY_RUSHER)
-		gcalc = GF_CostRusher;
+		profile = PATHCOST_RUSHER;
 	else
-		gcalc = GF_CostNormal;
+		profile = PATHCOST_NORMAL;
+
+	m_pathRequestSrc = srcIndex;
+	m_pathRequestDest = destIndex;
+	m_pathRequestProfile = profile;
+	m_pathRequestHeuristic = hcalc;
+
+	// asked from the bot think, search it in the next pass of the frame barrier instead of next frame
+	if (g_jobs->IsRunningEngineJobs() && !m_planQueued)
+	{
+		m_planQueued = true;
+
+		int maxExpansions = g_botManager->GetPathExpansions();
+		g_jobs->Push("BotPlanThink", [this, maxExpansions] { PlanThink(maxExpansions); }, JOB_PARALLEL);
+	}
+}
+
+// this function runs the pending path search, it's called from worker threads so it must not touch the engine
+void Bot::PlanThink(int maxExpansions)
+{
+	m_planQueued = false;
+
+	if (m_pathRequestDest == -1)
+		return;
+
+	if (m_searchState == nullptr)
+		m_searchState = AcquireWorkspace();
+
+	int srcIndex = m_pathRequestSrc;
+	int result = SearchPath(srcIndex, m_pathRequestDest, m_pathRequestProfile, m_pathRequestHeuristic, maxExpansions);
+
+	// keep the request and the workspace until the search is done
+	if (result == SEARCH_RUNNING)
+		return;
+
+	DeleteSearchState();
+	m_pathRequestDest = -1;
+
+	// no path? go to random waypoint in the act phase, random generator of the engine isn't thread safe
+	if (result == SEARCH_FAILED)
+		m_pathRetryIndex = srcIndex;
+}
+
+void Bot::DeleteSearchState(void)
+{
+	if (m_searchState == nullptr)
+		return;
+
+	ReleaseWorkspace(m_searchState);
+	m_searchState = nullptr;
+}
+
+// this function retries the failed path search with a random goal
+void Bot::CheckPathRetry(void)
+{
+	if (m_pathRetryIndex == -1)
+		return;
+
+	int srcIndex = m_pathRetryIndex;
+	m_pathRetryIndex = -1;
+
+	if (!g_waypoint->m_otherPoints.IsEmpty())
+		FindPath(srcIndex, g_waypoint->m_otherPoints.GetRandomElement());
+}
+
+// this function starts A* from srcIndex to destIndex, nothing is expanded yet
+static void StartSearch(SearchWorkspace& workspace, int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie, bool fullReset = false)
+{
+	workspace.Reset(fullReset);
+
+	workspace.srcIndex = srcIndex;
+	workspace.destIndex = destIndex;
+	workspace.requestIndex = destIndex;
+	workspace.profile = profile;
+	workspace.hcalc = hcalc;
+	workspace.team = team;
+	workspace.gravity = gravity;
+	workspace.isZombie = isZombie;
+
+	workspace.running = true;
+	workspace.expansions = 0;
+	workspace.numWaypoints = g_numWaypoints;
+	workspace.bestIndex = srcIndex;
+	workspace.bestHeuristic = hcalc(srcIndex, destIndex);
+	workspace.heuristicScale = hcalc == HF_Landmark ? g_pathCost->GetDistanceScale(profile, team, isZombie) : 1.0f;
+	workspace.epoch = (team >= 0 && team < TEAM_COUNT) ? g_pathCost->GetEpoch(profile, team, isZombie) : 0;
+	workspace.threat = GetThreatGeneration(profile, team);
 
 	// put start node into open list
-	auto srcWaypoint = &waypoints[srcIndex];
-	srcWaypoint->g = gcalc(srcIndex, -1, m_team, pev->gravity, m_isZombieBot);
-	srcWaypoint->f = AddFloat(srcWaypoint->g, hcalc(srcIndex, destIndex));
+	auto srcWaypoint = workspace.GetNode(srcIndex);
+	srcWaypoint->g = g_pathCost->GetCost(profile, srcIndex, -1, team, gravity, isZombie);
+	srcWaypoint->f = AddFloat(srcWaypoint->g, workspace.bestHeuristic * workspace.heuristicScale);
 	srcWaypoint->state = State::Open;
 
-	PriorityQueue openList;
-	openList.Insert(srcIndex, srcWaypoint->f);
+	workspace.GetOpenList().Insert(srcIndex, srcWaypoint->f);
+}
+
+// this function expands up to maxExpansions nodes (0 = until done), parents of the found path are left in the workspace
+static int ContinueSearch(SearchWorkspace& workspace, int maxExpansions)
+{
+	int destIndex = workspace.destIndex;
+	int profile = workspace.profile;
+	int team = workspace.team;
+	float gravity = workspace.gravity;
+	bool isZombie = workspace.isZombie;
+	PathHeuristicFunc hcalc = workspace.hcalc;
+
+	int expansions = 0;
+
+	PriorityQueue& openList = workspace.GetOpenList();
 	while (!openList.Empty())
 	{
+		if (maxExpansions > 0 && expansions >= maxExpansions)
+			return SEARCH_RUNNING;
+
 		// remove the first node from the open list
 		int currentIndex = openList.Remove();
 
 		// is the current node the goal node?
 		if (currentIndex == destIndex)
 		{
-			// delete path for new one
-			DeleteSearchNodes(true);
-
-			// build the complete path
-			m_navNode = nullptr;
-
-			do
-			{
-				PathNode* path = new PathNode;
-				if (path == nullptr)
-					return;
-
-				path->index = currentIndex;
-				path->next = m_navNode;
-
-				m_navNode = path;
-				currentIndex = waypoints[currentIndex].parent;
-			} while (currentIndex != -1);
-
-			m_navNodeStart = m_navNode;
-			m_pathtimer = Engine::GetReference()->GetTime();
-
-			return;
+			workspace.running = false;
+			return SEARCH_FOUND;
 		}
 
-		auto currWaypoint = &waypoints[currentIndex];
+		auto currWaypoint = workspace.GetNode(currentIndex);
 		if (currWaypoint->state != State::Open)
 			continue;
 
 		// put current node into Closed list
 		currWaypoint->state = State::Closed;
+		expansions++;
+		workspace.expansions++;
+
+		// remember the node nearest to the goal, bot can walk there while the search goes on
+		float heuristic = workspace.heuristicScale > 0.0f ? (currWaypoint->f - currWaypoint->g) / workspace.heuristicScale : hcalc(currentIndex, destIndex);
+		if (heuristic < workspace.bestHeuristic)
+		{
+			workspace.bestHeuristic = heuristic;
+			workspace.bestIndex = currentIndex;
+		}
 
 		// now expand the current node
-		for (int i = 0; i < Const_MaxPathIndex; i++)
+		int numLinks;
+		const int16* links = g_waypoint->GetLinks(currentIndex, numLinks);
+
+		for (int i = 0; i < numLinks; i++)
 		{
-			int self = g_waypoint->GetPath(currentIndex)->index[i];
+			int self = links[i];
 			if (self == -1)
 				continue;
 
 			// calculate the F value as F = G + H
-			float g = AddFloat(currWaypoint->g, gcalc(currentIndex, self, m_team, pev->gravity, m_isZombieBot));
-			float h = hcalc(self, destIndex);
+			float g = AddFloat(currWaypoint->g, g_pathCost->GetCost(profile, currentIndex, self, team, gravity, isZombie));
+			float h = hcalc(self, destIndex) * workspace.heuristicScale;
 			float f = AddFloat(g, h);
 
-			auto childWaypoint = &waypoints[self];
+			auto childWaypoint = workspace.GetNode(self);
 			if (childWaypoint->state == State::New || childWaypoint->f > f)
 			{
 				// put the current child into open list
@@ -1223,8 +2480,297 @@ void Bot::FindPath(int srcIndex, int destIndex)
 		}
 	}
 
-	// no path? go to random waypoint...
-	FindPath(srcIndex, g_waypoint->m_otherPoints.GetRandomElement());
+	workspace.running = false;
+	return SEARCH_FAILED;
+}
+
+// this function runs A* from srcIndex to destIndex at once
+static bool RunSearch(SearchWorkspace& workspace, int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int team, float gravity, bool isZombie, bool fullReset = false)
+{
+	StartSearch(workspace, srcIndex, destIndex, profile, hcalc, team, gravity, isZombie, fullReset);
+	return ContinueSearch(workspace, 0) == SEARCH_FOUND;
+}
+
+// this function returns the path from the search start to goalIndex
+static void ExtractPath(SearchWorkspace& workspace, int goalIndex, vector <int16>& path)
+{
+	int length = 0;
+	for (int currentIndex = goalIndex; currentIndex != -1; currentIndex = workspace.GetNode(currentIndex)->parent)
+		length++;
+
+	// walk back from the goal, path is stored from the start
+	path.resize(length);
+
+	for (int currentIndex = goalIndex; currentIndex != -1; currentIndex = workspace.GetNode(currentIndex)->parent)
+		path[--length] = static_cast <int16> (currentIndex);
+}
+
+// this function searches a path from srcIndex to destIndex, long searches are split over several frames
+int Bot::SearchPath(int srcIndex, int destIndex, int profile, PathHeuristicFunc hcalc, int maxExpansions)
+{
+	// deathmatch teams have no cost tables, and waypoints being edited make every cached path useless
+	bool useCache = m_team >= 0 && m_team < TEAM_COUNT && !g_waypointsChanged;
+
+	SearchWorkspace& workspace = *m_searchState;
+
+	// same goal as the unfinished search? just continue it, bot may have moved meanwhile
+	if (!workspace.IsRunning(destIndex, profile, hcalc, m_team, pev->gravity, m_isZombieBot))
+	{
+		// far goal? search only until the next cluster on the way, rest is searched when bot gets there
+		int goalIndex = destIndex;
+		if (ebot_path_clusters.GetBool() && g_pathClusters->IsValid())
+		{
+			int clusterExpansions;
+			goalIndex = g_pathClusters->GetNextGoal(srcIndex, destIndex, clusterExpansions);
+
+			// planning over the clusters is paid from the same budget, the search itself gets at least one node
+			if (maxExpansions > 0)
+				maxExpansions = clusterExpansions < maxExpansions ? maxExpansions - clusterExpansions : 1;
+		}
+
+		shared_ptr <const vector <int16> > cached;
+		if (useCache)
+			cached = g_pathCache->Find(srcIndex, goalIndex, profile, hcalc, m_team, pev->gravity, m_isZombieBot);
+
+		if (cached != nullptr)
+		{
+			// delete path for new one
+			DeleteSearchNodes(true);
+
+			SetPath(*cached);
+			m_pathGoalIndex = destIndex;
+			m_pathtimer = Engine::GetReference()->GetTime();
+
+			return SEARCH_FOUND;
+		}
+
+		StartSearch(workspace, srcIndex, goalIndex, profile, hcalc, m_team, pev->gravity, m_isZombieBot);
+		workspace.requestIndex = destIndex;
+	}
+
+	int result = ContinueSearch(workspace, maxExpansions);
+
+	if (result == SEARCH_RUNNING)
+	{
+		// out of budget, if there is nothing to follow walk to the node nearest to the goal for now
+		if (m_navNode == nullptr && workspace.bestIndex != workspace.srcIndex)
+		{
+			vector <int16> partial;
+			ExtractPath(workspace, workspace.bestIndex, partial);
+
+			SetPath(partial);
+			m_pathGoalIndex = destIndex;
+		}
+
+		return SEARCH_RUNNING;
+	}
+
+	if (result == SEARCH_FAILED)
+		return SEARCH_FAILED;
+
+	auto path = make_shared <vector <int16> >();
+	ExtractPath(workspace, workspace.destIndex, *path);
+
+	// costs or threat changed during the search, don't share it
+	if (useCache && workspace.epoch == g_pathCost->GetEpoch(profile, m_team, m_isZombieBot) && workspace.threat == GetThreatGeneration(profile, m_team))
+		g_pathCache->Insert(workspace.srcIndex, workspace.destIndex, profile, hcalc, m_team, pev->gravity, m_isZombieBot, path);
+
+	// delete path for new one
+	DeleteSearchNodes(true);
+
+	SetPath(*path);
+	m_pathGoalIndex = destIndex;
+	m_pathtimer = Engine::GetReference()->GetTime();
+
+	return SEARCH_FOUND;
+}
+
+// this function builds the node list of the bot, every bot owns its copy since nodes are removed while walking
+void Bot::SetPath(const vector <int16>& path)
+{
+	PathNode* node = m_navNodeStart;
+	while (node != nullptr)
+	{
+		PathNode* next = node->next;
+		delete node;
+
+		node = next;
+	}
+
+	// bot could walk a part of the path while it was searched, skip the waypoints behind it
+	int start = 0;
+	for (int i = 0; i < static_cast <int> (path.size()); i++)
+	{
+		if (path[i] == m_currentWaypointIndex)
+		{
+			start = i;
+			break;
+		}
+	}
+
+	m_navNode = nullptr;
+
+	for (int i = static_cast <int> (path.size()) - 1; i >= start; i--)
+	{
+		PathNode* pathNode = new PathNode;
+		pathNode->index = path[i];
+		pathNode->next = m_navNode;
+
+		m_navNode = pathNode;
+	}
+
+	m_navNodeStart = m_navNode;
+}
+
+// this function measures path search cost, legacy full reset of search state against generation stamps
+void BenchmarkPathfinding(edict_t* ent, int count)
+{
+	if (g_numWaypoints < 2)
+	{
+		ClientPrint(ent, print_console, "Not enough waypoints for path benchmark");
+		return;
+	}
+
+	if (count <= 0)
+		count = 1000;
+
+	// short paths are up to 16 nodes, long paths are everything above
+	const int shortPathNodes = 16;
+
+	double time[2][2] = { { 0.0, 0.0 }, { 0.0, 0.0 } };
+	int queries[2] = { 0, 0 };
+	int failed = 0;
+
+	// searches split over slices smaller than the path, like bots do with ebot_path_budget
+	int splitSearches = 0;
+	int splitCompleted = 0;
+
+	SearchWorkspace& workspace = GetSearchWorkspace();
+	g_pathCost->Prepare(PATHCOST_NORMAL, TEAM_COUNTER, false);
+
+	for (int i = 0; i < count; i++)
+	{
+		int srcIndex = Engine::GetReference()->RandomInt(0, g_numWaypoints - 1);
+		int destIndex = Engine::GetReference()->RandomInt(0, g_numWaypoints - 1);
+
+		double elapsed[2];
+		bool found = false;
+
+		for (int mode = 0; mode < 2; mode++)
+		{
+			auto start = chrono::high_resolution_clock::now();
+			found = RunSearch(workspace, srcIndex, destIndex, PATHCOST_NORMAL, HF_Distance, TEAM_COUNTER, 1.0f, false, mode == 0);
+			elapsed[mode] = chrono::duration <double, micro>(chrono::high_resolution_clock::now() - start).count();
+		}
+
+		if (!found)
+		{
+			failed++;
+			continue;
+		}
+
+		int nodes = 0;
+		for (int index = destIndex; index != -1; index = workspace.GetNode(index)->parent)
+			nodes++;
+
+		int type = nodes <= shortPathNodes ? 0 : 1;
+
+		queries[type]++;
+		time[type][0] += elapsed[0];
+		time[type][1] += elapsed[1];
+
+		if (nodes < 4)
+			continue;
+
+		float cost = workspace.GetNode(destIndex)->g;
+
+		// resume the search until it's done, it must end with the same path cost as the one shot search
+		StartSearch(workspace, srcIndex, destIndex, PATHCOST_NORMAL, HF_Distance, TEAM_COUNTER, 1.0f, false);
+
+		int result = SEARCH_RUNNING;
+		for (int slice = 0; slice <= g_numWaypoints && result == SEARCH_RUNNING; slice++)
+			result = ContinueSearch(workspace, nodes / 4);
+
+		splitSearches++;
+		if (result == SEARCH_FOUND && workspace.GetNode(destIndex)->g == cost)
+			splitCompleted++;
+	}
+
+	ClientPrint(ent, print_console, "Path benchmark: %d queries on %d waypoints (%d without path)", count, g_numWaypoints, failed);
+
+	const char* typeNames[2] = { "short", "long" };
+	for (int type = 0; type < 2; type++)
+	{
+		if (queries[type] == 0)
+			continue;
+
+		ClientPrint(ent, print_console, "%5s paths: %5d queries, full reset %8.2f us, generation stamps %8.2f us per query", typeNames[type], queries[type], time[type][0] / queries[type], time[type][1] / queries[type]);
+	}
+
+	if (splitSearches > 0)
+		ClientPrint(ent, print_console, "Split searches: %d of %d finished with the one shot path cost%s", splitCompleted, splitSearches, splitCompleted == splitSearches ? "" : " - FAILED");
+}
+
+// this function compares node expansions, time and path length of the heuristics on same random paths
+void BenchmarkHeuristics(edict_t* ent, int count)
+{
+	if (g_numWaypoints < 2)
+	{
+		ClientPrint(ent, print_console, "Not enough waypoints for heuristic benchmark");
+		return;
+	}
+
+	if (count <= 0)
+		count = 1000;
+
+	const int numHeuristics = 4;
+	const PathHeuristicFunc heuristics[numHeuristics] = { HF_Distance, HF_Mannhattan, HF_Cheby, HF_Landmark };
+	const char* names[numHeuristics] = { "distance", "manhattan", "chebyshev", "landmark" };
+
+	if (!g_landmarks->IsValid())
+		g_landmarks->Build();
+
+	double time[numHeuristics] = { 0.0, 0.0, 0.0, 0.0 };
+	double expansions[numHeuristics] = { 0.0, 0.0, 0.0, 0.0 };
+	double length[numHeuristics] = { 0.0, 0.0, 0.0, 0.0 };
+	int queries = 0;
+
+	SearchWorkspace& workspace = GetSearchWorkspace();
+	g_pathCost->Prepare(PATHCOST_NORMAL, TEAM_COUNTER, false);
+
+	vector <int16> path;
+
+	for (int i = 0; i < count; i++)
+	{
+		int srcIndex = Engine::GetReference()->RandomInt(0, g_numWaypoints - 1);
+		int destIndex = Engine::GetReference()->RandomInt(0, g_numWaypoints - 1);
+
+		if (!g_waypoint->IsReachable(srcIndex, destIndex))
+			continue;
+
+		queries++;
+
+		for (int h = 0; h < numHeuristics; h++)
+		{
+			auto start = chrono::high_resolution_clock::now();
+			RunSearch(workspace, srcIndex, destIndex, PATHCOST_NORMAL, heuristics[h], TEAM_COUNTER, 1.0f, false);
+			time[h] += chrono::duration <double, micro>(chrono::high_resolution_clock::now() - start).count();
+
+			expansions[h] += workspace.expansions;
+
+			ExtractPath(workspace, destIndex, path);
+			for (int j = 1; j < static_cast <int> (path.size()); j++)
+				length[h] += (g_waypoint->GetPath(path[j])->origin - g_waypoint->GetPath(path[j - 1])->origin).GetLength();
+		}
+	}
+
+	ClientPrint(ent, print_console, "Heuristic benchmark: %d reachable queries on %d waypoints", queries, g_numWaypoints);
+
+	if (queries == 0)
+		return;
+
+	for (int h = 0; h < numHeuristics; h++)
+		ClientPrint(ent, print_console, "%10s: %8.1f expansions, %8.2f us, %8.1f units path length per query", names[h], expansions[h] / queries, time[h] / queries, length[h] / queries);
 }
 
 void Bot::DeleteSearchNodes(bool skip)
@@ -1249,6 +2795,13 @@ void Bot::DeleteSearchNodes(bool skip)
 	m_navNodeStart = nullptr;
 	m_navNode = nullptr;
 	m_chosenGoalIndex = -1;
+	m_pathGoalIndex = -1;
+
+	// forget the pending search too
+	m_pathRequestDest = -1;
+	m_pathRetryIndex = -1;
+
+	DeleteSearchState();
 }
 
 void Bot::CheckTouchEntity(edict_t* entity)
@@ -1308,7 +2861,10 @@ void Bot::SetEnemy(edict_t* entity)
 	}
 
 	if (m_enemy != entity)
+	{
 		m_enemyReachableTimer = 0.0f;
+		g_threatMap->AddThreat(GetEntityWaypoint(entity), m_team, Const_ThreatSighting);
+	}
 
 	m_enemy = entity;
 }
@@ -1390,7 +2946,7 @@ int Bot::GetAimingWaypoint(Vector targetOriginPos)
 
 	while (destIndex != srcIndex)
 	{
-		destIndex = *(g_waypoint->m_pathMatrix + (destIndex * g_numWaypoints) + srcIndex);
+		destIndex = g_waypoint->GetNextHop(destIndex, srcIndex);
 
 		if (destIndex < 0)
 			break;
@@ -1784,6 +3340,8 @@ int Bot::FindDefendWaypoint(Vector origin)
 	return g_waypoint->m_campPoints.GetRandomElement();
 }
 
+const int Const_CoverTraces = 8; // spots confirmed with a trace per cover search
+
 int Bot::FindCoverWaypoint(float maxDistance)
 {
 	// really?
@@ -1795,71 +3353,87 @@ int Bot::FindCoverWaypoint(float maxDistance)
 	if (maxDistance > enemydist)
 		maxDistance = enemydist;
 
-	Array <int> BestSpots;
-	Array <int> OkSpots;
+	Vector origin = !FNullEnt(m_enemy) ? GetPlayerHeadOrigin(m_enemy) : GetPlayerHeadOrigin(m_lastEnemy);
 
-	int ChoosenIndex = -1;
+	// waypoints visible from the enemy's waypoint can't be cover, the visibility table tells it without tracing
+	vector <uint32_t> visible;
+	int enemyIndex = g_waypoint->FindNearest(!FNullEnt(m_enemy) ? GetEntityOrigin(m_enemy) : m_lastEnemyOrigin);
 
-	for (int i = 0; i < g_numWaypoints; i++)
+	if (IsValidWaypoint(enemyIndex))
+		g_waypoint->GetVisibleSet(enemyIndex, VISROW_ANY, visible);
+
+	auto IsCandidate = [&](int index)
 	{
-		if (g_waypoint->GetPath(i)->flags & WAYPOINT_LADDER)
-			continue;
+		Path* path = g_waypoint->GetPath(index);
 
-		if (g_waypoint->GetPath(i)->flags & WAYPOINT_AVOID)
-			continue;
+		if (path->flags & (WAYPOINT_LADDER | WAYPOINT_AVOID | WAYPOINT_FALLCHECK))
+			return false;
 
-		if (g_waypoint->GetPath(i)->flags & WAYPOINT_FALLCHECK)
-			continue;
+		if (!visible.empty() && (visible[index >> 5] & (1u << (index & 31))))
+			return false;
 
-		TraceResult tr{};
-		Vector origin = !FNullEnt(m_enemy) ? GetPlayerHeadOrigin(m_enemy) : GetPlayerHeadOrigin(m_lastEnemy);
-		TraceLine(g_waypoint->GetPath(i)->origin, origin, true, true, GetEntity(), &tr);
+		return !IsWaypointOccupied(index);
+	};
+
+	// prefer spots near the enemy, distance isn't matter if there is none
+	vector <int> candidates;
+
+	Array <int> nearby;
+	g_waypoint->FindInRadius(nearby, maxDistance, origin);
 
-		if (tr.flFraction != 1.0f && !IsWaypointOccupied(i) && (g_waypoint->GetPath(i)->origin - origin).GetLength2D() <= maxDistance)
-			BestSpots.Push(i);
-		else if (tr.flFraction != 1.0f && !IsWaypointOccupied(i)) // distance isn't matter now
-			OkSpots.Push(i);
+	for (int i = 0; i < nearby.GetElementNumber(); i++)
+	{
+		if (IsCandidate(nearby[i]))
+			candidates.push_back(nearby[i]);
 	}
 
-	if (!BestSpots.IsEmpty() && !IsValidWaypoint(ChoosenIndex))
+	if (candidates.empty())
 	{
-		for (int i = 0; i < BestSpots.GetElementNumber(); i++)
+		for (int i = 0; i < g_numWaypoints; i++)
 		{
-			if (!IsValidWaypoint(i))
-				continue;
+			if (IsCandidate(i))
+				candidates.push_back(i);
+		}
+	}
 
-			float maxdist = maxDistance;
-			float experience = float(g_exp.GetDamage(i, i, m_team) * 100 / MAX_EXPERIENCE_VALUE) + (g_exp.GetDangerIndex(i, i, m_team) * 100 / MAX_EXPERIENCE_VALUE) + g_exp.GetKillHistory();
-			float distance = ((pev->origin - g_waypoint->GetPath(i)->origin).GetLength2D() + experience);
+	vector <float> scores(candidates.size());
 
-			if (distance < maxdist)
-			{
-				ChoosenIndex = i;
-				maxdist = distance;
-			}
-		}
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		int index = candidates[i];
+		float experience = float(g_exp.GetDamage(index, index, m_team) * 100 / MAX_EXPERIENCE_VALUE) + (g_exp.GetDangerIndex(index, index, m_team) * 100 / MAX_EXPERIENCE_VALUE) + g_exp.GetKillHistory();
+
+		// don't hide where the team is just getting shot
+		experience += g_threatMap->GetThreat(index, m_team);
+
+		scores[i] = (pev->origin - g_waypoint->GetPath(index)->origin).GetLength2D() + experience;
 	}
-	else if (!OkSpots.IsEmpty() && !IsValidWaypoint(ChoosenIndex))
+
+	// the table is traced from waypoint to waypoint, so confirm only the best few spots against the enemy's head
+	for (int tries = 0; tries < Const_CoverTraces && !candidates.empty(); tries++)
 	{
-		for (int i = 0; i < OkSpots.GetElementNumber(); i++)
+		size_t best = 0;
+
+		for (size_t i = 1; i < candidates.size(); i++)
 		{
-			if (!IsValidWaypoint(i))
-				continue;
+			if (scores[i] < scores[best])
+				best = i;
+		}
 
-			float maxdist = 999999.0f;
-			float experience = float(g_exp.GetDamage(i, i, m_team) * 100 / MAX_EXPERIENCE_VALUE) + (g_exp.GetDangerIndex(i, i, m_team) * 100 / MAX_EXPERIENCE_VALUE) + g_exp.GetKillHistory();
-			float distance = ((pev->origin - g_waypoint->GetPath(i)->origin).GetLength2D() + experience);
+		int index = candidates[best];
 
-			if (distance < maxdist)
-			{
-				ChoosenIndex = i;
-				maxdist = distance;
-			}
-		}
-	}
+		TraceResult tr{};
+		TraceLine(g_waypoint->GetPath(index)->origin, origin, true, true, GetEntity(), &tr);
 
-	if (IsValidWaypoint(ChoosenIndex))
-		return ChoosenIndex;
+		if (tr.flFraction != 1.0f)
+			return index;
+
+		candidates[best] = candidates.back();
+		scores[best] = scores.back();
+
+		candidates.pop_back();
+		scores.pop_back();
+	}
 
 	return -1; // do not use random points
 }
@@ -3294,21 +4868,8 @@ bool Bot::IsWaypointOccupied(int index)
 	if (IsAntiBlock(GetEntity()))
 		return false;
 
-	for (int i = 0; i < Engine::GetReference()->GetMaxClients(); i++)
-	{
-		edict_t* player = INDEXENT(i+1);
-		if (!IsAlive(player) || player == GetEntity())
-			continue;
-
-		if ((g_waypoint->GetPath(index)->origin - GetEntityOrigin(player)).GetLengthSquared() <= (64.0f * 64.0f))
-			return true;
-
-		Bot* bot = g_botManager->GetBot(i);
-		if (bot != nullptr && bot->m_currentWaypointIndex == index)
-			return true;
-	}
-
-	return false;
+	// players near the waypoints are collected once per frame for all bots
+	return g_blackboard.IsOccupied(index, GetIndex() - 1);
 }
 
 // this function tries to find nearest to current bot button, and returns pointer to
@@ -271,6 +271,9 @@ void NetworkMsg::Execute(void* p)
             if (FNullEnt(victim) || !IsValidPlayer(victim))
                 break;
 
+            // teammates of the victim should avoid this place for a while
+            g_threatMap->AddThreat(GetEntityWaypoint(victim), GetTeam(victim), Const_ThreatDeath);
+
             Bot* victimer = g_botManager->GetBot(victim);
             if (victimer != nullptr)
             {
@@ -43,6 +43,7 @@ void TraceLine(const Vector& start, const Vector& end, bool ignoreMonsters, bool
 	// in ignoreEntity in order to ignore it as a possible obstacle.
 	// this is an overloaded prototype to add IGNORE_GLASS in the same way as IGNORE_MONSTERS work.
 
+	lock_guard <mutex> lock(g_traceLock);
 	(*g_engfuncs.pfnTraceLine) (start, end, (ignoreMonsters ? 1 : 0) | (ignoreGlass ? 0x100 : 0), ignoreEntity, ptr);
 }
 
@@ -56,6 +57,7 @@ void TraceLine(const Vector& start, const Vector& end, bool ignoreMonsters, edic
 	// whether the trace starts "inside" an entity's polygonal model, and if so, to specify that entity
 	// in ignoreEntity in order to ignore it as a possible obstacle.
 
+	lock_guard <mutex> lock(g_traceLock);
 	(*g_engfuncs.pfnTraceLine) (start, end, ignoreMonsters ? 1 : 0, ignoreEntity, ptr);
 }
 
@@ -72,6 +74,7 @@ void TraceHull(const Vector& start, const Vector& end, bool ignoreMonsters, int
 	// function allows to specify whether the trace starts "inside" an entity's polygonal model,
 	// and if so, to specify that entity in ignoreEntity in order to ignore it as an obstacle.
 
+	lock_guard <mutex> lock(g_traceLock);
 	(*g_engfuncs.pfnTraceHull) (start, end, ignoreMonsters ? 1 : 0, hullNumber, ignoreEntity, ptr);
 }
 
@@ -697,6 +700,10 @@ void RoundInit(void)
 	g_audioTime = 0.0f;
 	g_botManager->InitQuota();
 
+	// players are back at spawn, old fights don't matter anymore
+	g_threatMap->Reset();
+	g_blackboard.Reset();
+
 	if (GetGameMode() == MODE_BASE)
 	{
 		// check team economics
@@ -991,7 +998,10 @@ lastly:
 	if (GetGameMode() != MODE_BASE)
 		g_mapType |= MAP_DE;
 	else
+	{
 		g_exp.UpdateGlobalKnowledge(); // update experience data on round start
+		g_exp.Save(); // written in background, so it's cheap to keep the file fresh
+	}
 }
 
 bool IsWeaponShootingThroughWall(int id)
@@ -31,6 +31,8 @@ ConVar ebot_analyze_wall_check_distance("ebot_analyze_wall_check_distance", "24"
 ConVar ebot_analyze_max_jump_height("ebot_analyze_max_jump_height", "44");
 ConVar ebot_analyze_goal_check_distance("ebot_analyze_goal_check_distance", "200");
 ConVar ebot_analyze_create_camp_waypoints("ebot_analyze_create_camp_waypoints", "1");
+ConVar ebot_visibility_traces("ebot_visibility_traces", "4096"); // per frame while the visibility table is built
+ConVar ebot_waypoint_pack_tables("ebot_waypoint_pack_tables", "1"); // put visibility and path matrix into the saved waypoint file
 
 // this function initialize the waypoint structures..
 void Waypoint::Initialize(void)
@@ -39,14 +41,29 @@ void Waypoint::Initialize(void)
     if (m_waypointPaths)
     {
         for (int i = 0; i < g_numWaypoints; i++)
-        {
-            delete m_paths[i];
             m_paths[i] = nullptr;
-        }
     }
 
+    // all paths are free now
+    ResetPaths();
+
+    // waypoint indexed arrays are sized again for the new waypoints
+    m_paths.clear();
+    m_waypointDisplayTime.clear();
+    m_goalsScore.clear();
+
     g_numWaypoints = 0;
     m_lastWaypoint = nullvec;
+    m_gridDirty = true;
+
+    // matrix is built again from the new waypoints as they get connected
+    m_matrixFile.Close();
+    m_matrixBuffer.clear();
+    m_distMatrix = nullptr;
+    m_pathMatrix = nullptr;
+    m_matrixSize = 0;
+    m_matrixStride = 0;
+    m_matrixEditing = false;
 }
 
 void AnalyzeThread(void)
@@ -278,6 +295,9 @@ void Waypoint::AddPath(int addIndex, int pathIndex, float distance, int type)
     if (!IsValidWaypoint(addIndex) || !IsValidWaypoint(pathIndex) || addIndex == pathIndex)
         return;
 
+    m_componentsDirty = true;
+    m_linksDirty = true;
+
     Path* path = m_paths[addIndex];
 
     // don't allow paths get connected twice
@@ -297,6 +317,8 @@ void Waypoint::AddPath(int addIndex, int pathIndex, float distance, int type)
         {
             path->index[i] = static_cast <int16> (pathIndex);
             path->distances[i] = abs(static_cast <int> (distance));
+            AddPathToMatrix(addIndex, pathIndex, path->distances[i]);
+
             if (type == 1)
             {
                 path->connectionFlags[i] |= PATHFLAG_JUMP;
@@ -329,8 +351,16 @@ void Waypoint::AddPath(int addIndex, int pathIndex, float distance, int type)
     if (slotID != -1)
     {
         AddLogEntry(LOG_DEFAULT, "Path added from %d to %d", addIndex, pathIndex);
+
+        // drop the old connection from the matrix first, then add the new one
+        RemovePathFromMatrix(addIndex, path->index[slotID], path->distances[slotID]);
+        path->index[slotID] = -1;
+        UpdatePathMatrix();
+
         path->index[slotID] = static_cast <int16> (pathIndex);
         path->distances[slotID] = abs(static_cast <int> (distance));
+        AddPathToMatrix(addIndex, pathIndex, path->distances[slotID]);
+
         if (type == 1)
         {
             path->connectionFlags[slotID] |= PATHFLAG_JUMP;
@@ -345,19 +375,230 @@ void Waypoint::AddPath(int addIndex, int pathIndex, float distance, int type)
     }
 }
 
+const float Const_GridCellSize = 256.0f;
+const int Const_MaxGridCells = 128; // per axis, cells get bigger on huge maps
+
+// this function puts all waypoints into the grid cells
+void Waypoint::InitGrid(void)
+{
+    m_gridDirty = false;
+    m_gridNumWaypoints = 0;
+    m_gridWidth = 0;
+    m_gridHeight = 0;
+    m_grid.clear();
+
+    m_originX.resize(g_numWaypoints);
+    m_originY.resize(g_numWaypoints);
+    m_originZ.resize(g_numWaypoints);
+
+    if (g_numWaypoints <= 0)
+        return;
+
+    float minX = m_paths[0]->origin.x, maxX = minX;
+    float minY = m_paths[0]->origin.y, maxY = minY;
+    float minZ = m_paths[0]->origin.z, maxZ = minZ;
+
+    for (int i = 1; i < g_numWaypoints; i++)
+    {
+        const Vector& origin = m_paths[i]->origin;
+
+        if (origin.x < minX)
+            minX = origin.x;
+        else if (origin.x > maxX)
+            maxX = origin.x;
+
+        if (origin.y < minY)
+            minY = origin.y;
+        else if (origin.y > maxY)
+            maxY = origin.y;
+
+        if (origin.z < minZ)
+            minZ = origin.z;
+        else if (origin.z > maxZ)
+            maxZ = origin.z;
+    }
+
+    // leave some room for new waypoints, so adding them doesn't need a rebuild
+    minX -= Const_GridCellSize * 4.0f;
+    minY -= Const_GridCellSize * 4.0f;
+    maxX += Const_GridCellSize * 4.0f;
+    maxY += Const_GridCellSize * 4.0f;
+
+    m_gridCellSize = Const_GridCellSize;
+
+    float extent = (maxX - minX) > (maxY - minY) ? (maxX - minX) : (maxY - minY);
+    if (extent / m_gridCellSize >= Const_MaxGridCells)
+        m_gridCellSize = extent / (Const_MaxGridCells - 1);
+
+    m_gridMinX = minX;
+    m_gridMinY = minY;
+    m_gridMinZ = minZ;
+    m_gridMaxZ = maxZ;
+    m_gridWidth = static_cast <int> ((maxX - minX) / m_gridCellSize) + 1;
+    m_gridHeight = static_cast <int> ((maxY - minY) / m_gridCellSize) + 1;
+
+    m_grid.resize(m_gridWidth * m_gridHeight);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        AddToGrid(i);
+}
+
+// this function puts the new waypoint into its cell
+void Waypoint::AddToGrid(int index)
+{
+    const Vector& origin = m_paths[index]->origin;
+
+    if (index >= static_cast <int> (m_originX.size()))
+    {
+        m_originX.resize(index + 1);
+        m_originY.resize(index + 1);
+        m_originZ.resize(index + 1);
+    }
+
+    m_originX[index] = origin.x;
+    m_originY[index] = origin.y;
+    m_originZ[index] = origin.z;
+
+    int x, y;
+    GetGridCell(origin, x, y);
+
+    if (x < 0 || y < 0 || x >= m_gridWidth || y >= m_gridHeight)
+    {
+        m_gridDirty = true;
+        return;
+    }
+
+    m_grid[y * m_gridWidth + x].push_back(index);
+    m_gridNumWaypoints++;
+
+    if (origin.z < m_gridMinZ)
+        m_gridMinZ = origin.z;
+    else if (origin.z > m_gridMaxZ)
+        m_gridMaxZ = origin.z;
+}
+
+// this function returns the cell of origin, it can be out of the grid
+void Waypoint::GetGridCell(const Vector& origin, int& x, int& y)
+{
+    x = static_cast <int> (floorf((origin.x - m_gridMinX) / m_gridCellSize));
+    y = static_cast <int> (floorf((origin.y - m_gridMinY) / m_gridCellSize));
+}
+
+// this function returns all waypoints within radius sorted by index, only the cells around origin are checked
+void Waypoint::FindInGridRadius(const Vector& origin, float radius, vector <int>& result)
+{
+    result.clear();
+
+    if (m_gridDirty || m_gridNumWaypoints != g_numWaypoints)
+        InitGrid();
+
+    if (m_grid.empty())
+        return;
+
+    int minX, minY, maxX, maxY;
+    GetGridCell(origin - Vector(radius, radius, 0.0f), minX, minY);
+    GetGridCell(origin + Vector(radius, radius, 0.0f), maxX, maxY);
+
+    if (minX < 0)
+        minX = 0;
+
+    if (minY < 0)
+        minY = 0;
+
+    if (maxX >= m_gridWidth)
+        maxX = m_gridWidth - 1;
+
+    if (maxY >= m_gridHeight)
+        maxY = m_gridHeight - 1;
+
+    float squaredRadius = SquaredF(radius);
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            for (int index : m_grid[y * m_gridWidth + x])
+            {
+                float dx = m_originX[index] - origin.x, dy = m_originY[index] - origin.y, dz = m_originZ[index] - origin.z;
+                if (dx * dx + dy * dy + dz * dz >= squaredRadius)
+                    continue;
+
+                // callers expect the waypoints in index order
+                int pos = static_cast <int> (result.size());
+                result.push_back(index);
+
+                while (pos > 0 && result[pos - 1] > index)
+                {
+                    result[pos] = result[pos - 1];
+                    pos--;
+                }
+
+                result[pos] = index;
+            }
+        }
+    }
+}
+
 // find the farest node to that origin, and return the index to this node
 int Waypoint::FindFarest(const Vector& origin, float maxDistance)
 {
     float squaredDistance = MultiplyFloat(maxDistance, maxDistance);
 
+    if (m_gridDirty || m_gridNumWaypoints != g_numWaypoints)
+        InitGrid();
+
+    int centerX = 0, centerY = 0;
+    if (!m_grid.empty())
+        GetGridCell(origin, centerX, centerY);
+
+    int maxRing = 0;
+    int edges[4] = { centerX, m_gridWidth - 1 - centerX, centerY, m_gridHeight - 1 - centerY };
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (abs(edges[i]) > maxRing)
+            maxRing = abs(edges[i]);
+    }
+
+    if (m_grid.empty())
+        maxRing = -1;
+
+    float heightDiff = fabsf(origin.z - m_gridMinZ) > fabsf(origin.z - m_gridMaxZ) ? fabsf(origin.z - m_gridMinZ) : fabsf(origin.z - m_gridMaxZ);
+
+    // outer rings first, stop when even the far corner of a ring can't beat the best
     int index = -1;
-    for (int i = 0; i < g_numWaypoints; i++)
+    for (int ring = maxRing; ring >= 0; ring--)
     {
-        float distance = (m_paths[i]->origin - origin).GetLengthSquared();
-        if (distance > squaredDistance)
+        float ringDistance = (ring + 1) * m_gridCellSize;
+        if (2.0f * SquaredF(ringDistance) + SquaredF(heightDiff) < squaredDistance)
+            break;
+
+        for (int y = centerY - ring; y <= centerY + ring; y++)
         {
-            index = i;
-            squaredDistance = distance;
+            if (y < 0 || y >= m_gridHeight)
+                continue;
+
+            // only first and last row of the ring are full, other rows have just the two side cells
+            int step = (abs(y - centerY) == ring) ? 1 : 2 * ring;
+
+            for (int x = centerX - ring; x <= centerX + ring; x += step)
+            {
+                if (x < 0 || x >= m_gridWidth)
+                    continue;
+
+                for (int i : m_grid[y * m_gridWidth + x])
+                {
+                    float dx = m_originX[i] - origin.x, dy = m_originY[i] - origin.y, dz = m_originZ[i] - origin.z;
+                    float distance = dx * dx + dy * dy + dz * dz;
+
+                    // lowest index wins ties, like the scan in index order did
+                    if (distance > squaredDistance || (index != -1 && distance == squaredDistance && i < index))
+                    {
+                        index = i;
+                        squaredDistance = distance;
+                    }
+                }
+            }
         }
     }
 
@@ -438,38 +679,85 @@ int Waypoint::FindNearest(Vector origin, float minDistance, int flags, edict_t*
         wpDistance[i] = FLT_MAX;
     }
 
-    for (int i = 0; i < g_numWaypoints; i++)
+    if (m_gridDirty || m_gridNumWaypoints != g_numWaypoints)
+        InitGrid();
+
+    int centerX = 0, centerY = 0;
+    if (!m_grid.empty())
+        GetGridCell(origin, centerX, centerY);
+
+    int maxRing = 0;
+    int edges[4] = { centerX, m_gridWidth - 1 - centerX, centerY, m_gridHeight - 1 - centerY };
+
+    for (int i = 0; i < 4; i++)
     {
-        if (flags != -1 && !(m_paths[i]->flags & flags))
-            continue;
+        if (abs(edges[i]) > maxRing)
+            maxRing = abs(edges[i]);
+    }
 
-        float distance = (m_paths[i]->origin - origin).GetLengthSquared();
-        if (distance > squaredMinDistance)
-            continue;
+    if (m_grid.empty())
+        maxRing = -1;
 
-        Vector dest = m_paths[i]->origin;
-        float distance2D = (dest - origin).GetLengthSquared2D();
-        if (((dest.z > origin.z + 62.0f || dest.z < origin.z - 100.0f) &&
-            !(m_paths[i]->flags & WAYPOINT_LADDER)) && distance2D <= SquaredF(30.0f))
-            continue;
+    // check the cells in rings around origin, waypoints of next ring are at least (ring - 1) cells away
+    for (int ring = 0; ring <= maxRing; ring++)
+    {
+        if (ring > 0)
+        {
+            float ringDistance = SquaredF((ring - 1) * m_gridCellSize);
+            if (ringDistance > squaredMinDistance || (wpIndex[checkPoint - 1] != -1 && wpDistance[checkPoint - 1] < ringDistance))
+                break;
+        }
 
-        for (int y = 0; y < checkPoint; y++)
+        for (int cellY = centerY - ring; cellY <= centerY + ring; cellY++)
         {
-            if (distance >= wpDistance[y])
+            if (cellY < 0 || cellY >= m_gridHeight)
                 continue;
 
-            for (int z = checkPoint - 1; z >= y; z--)
+            // only first and last row of the ring are full, other rows have just the two side cells
+            int step = (abs(cellY - centerY) == ring) ? 1 : 2 * ring;
+
+            for (int cellX = centerX - ring; cellX <= centerX + ring; cellX += step)
             {
-                if (z == checkPoint - 1 || wpIndex[z] == -1)
+                if (cellX < 0 || cellX >= m_gridWidth)
                     continue;
 
-                wpIndex[z + 1] = wpIndex[z];
-                wpDistance[z + 1] = wpDistance[z];
-            }
+                for (int i : m_grid[cellY * m_gridWidth + cellX])
+                {
+                    if (flags != -1 && !(m_paths[i]->flags & flags))
+                        continue;
 
-            wpIndex[y] = i;
-            wpDistance[y] = distance;
-            y = checkPoint + 5;
+                    float dx = m_originX[i] - origin.x, dy = m_originY[i] - origin.y, dz = m_originZ[i] - origin.z;
+                    float distance2D = dx * dx + dy * dy;
+                    float distance = distance2D + dz * dz;
+                    if (distance > squaredMinDistance)
+                        continue;
+
+                    float destZ = m_originZ[i];
+                    if (((destZ > origin.z + 62.0f || destZ < origin.z - 100.0f) &&
+                        !(m_paths[i]->flags & WAYPOINT_LADDER)) && distance2D <= SquaredF(30.0f))
+                        continue;
+
+                    // cells aren't visited in index order, so lower index goes first on same distance
+                    for (int y = 0; y < checkPoint; y++)
+                    {
+                        if (distance > wpDistance[y] || (distance == wpDistance[y] && i > wpIndex[y]))
+                            continue;
+
+                        for (int z = checkPoint - 1; z >= y; z--)
+                        {
+                            if (z == checkPoint - 1 || wpIndex[z] == -1)
+                                continue;
+
+                            wpIndex[z + 1] = wpIndex[z];
+                            wpDistance[z + 1] = wpDistance[z];
+                        }
+
+                        wpIndex[y] = i;
+                        wpDistance[y] = distance;
+                        y = checkPoint + 5;
+                    }
+                }
+            }
         }
     }
 
@@ -555,16 +843,16 @@ void Waypoint::FindInRadius(Vector origin, float radius, int* holdTab, int* coun
     int maxCount = *count;
     *count = 0;
 
-    for (int i = 0; i < g_numWaypoints; i++)
+    vector <int> found;
+    FindInGridRadius(origin, radius, found);
+
+    for (int index : found)
     {
-        if ((m_paths[i]->origin - origin).GetLengthSquared() < SquaredF(radius))
-        {
-            *holdTab++ = i;
-            *count += 1;
+        *holdTab++ = index;
+        *count += 1;
 
-            if (*count >= maxCount)
-                break;
-        }
+        if (*count >= maxCount)
+            break;
     }
 
     *count -= 1;
@@ -572,11 +860,11 @@ void Waypoint::FindInRadius(Vector origin, float radius, int* holdTab, int* coun
 
 void Waypoint::FindInRadius(Array <int>& queueID, float radius, Vector origin)
 {
-    for (int i = 0; i < g_numWaypoints; i++)
-    {
-        if ((m_paths[i]->origin - origin).GetLengthSquared() < SquaredF(radius))
-            queueID.Push(i);
-    }
+    vector <int> found;
+    FindInGridRadius(origin, radius, found);
+
+    for (int index : found)
+        queueID.Push(index);
 }
 
 void Waypoint::SgdWp_Set(const char* modset)
@@ -688,6 +976,8 @@ void Waypoint::Add(int flags, Vector waypointOrigin)
         g_botManager->RemoveAll();
 
     g_waypointsChanged = true;
+    m_componentsDirty = true;
+    m_linksDirty = true;
 
     switch (flags)
     {
@@ -725,7 +1015,10 @@ void Waypoint::Add(int flags, Vector waypointOrigin)
                     accumFlags += path->connectionFlags[i];
 
                 if (accumFlags == 0)
+                {
                     path->origin = (path->origin + GetEntityOrigin(g_hostEntity)) / 2;
+                    m_gridDirty = true;
+                }
             }
         }
         break;
@@ -739,12 +1032,9 @@ void Waypoint::Add(int flags, Vector waypointOrigin)
             return;
 
         index = g_numWaypoints;
+        ReserveWaypoints(index + 1);
 
-        if (m_paths[index] != nullptr)
-        {
-            delete m_paths[index];
-        }
-        m_paths[index] = new Path;
+        m_paths[index] = AllocPath();
         if (m_paths[index] == nullptr)
             return;
 
@@ -758,6 +1048,9 @@ void Waypoint::Add(int flags, Vector waypointOrigin)
         // store the origin (location) of this waypoint
         path->origin = newOrigin;
 
+        if (!m_gridDirty)
+            AddToGrid(index);
+
         path->campEndX = 0;
         path->campEndY = 0;
         path->campStartX = 0;
@@ -991,6 +1284,9 @@ void Waypoint::Add(int flags, Vector waypointOrigin)
 void Waypoint::Delete(void)
 {
     g_waypointsChanged = true;
+    m_componentsDirty = true;
+    m_linksDirty = true;
+    m_gridDirty = true;
 
     if (g_numWaypoints < 1)
         return;
@@ -1006,6 +1302,8 @@ void Waypoint::Delete(void)
     Path* path = nullptr;
     InternalAssert(m_paths[index] != nullptr);
 
+    RemoveWaypointFromMatrix(index);
+
     int i, j;
 
     for (i = 0; i < g_numWaypoints; i++) // delete all references to Node
@@ -1039,22 +1337,29 @@ void Waypoint::Delete(void)
     }
 
     // free deleted node
-    delete m_paths[index];
+    FreePath(m_paths[index]);
     m_paths[index] = nullptr;
 
     // Rotate Path Array down
     for (i = index; i < g_numWaypoints - 1; i++)
         m_paths[i] = m_paths[i + 1];
 
+    m_paths[g_numWaypoints - 1] = nullptr;
+
     g_numWaypoints--;
     m_waypointDisplayTime[index] = 0;
 
+    UpdatePathMatrix();
+
     PlaySound(g_hostEntity, "weapons/mine_activate.wav");
 }
 
 void Waypoint::DeleteByIndex(int index)
 {
     g_waypointsChanged = true;
+    m_componentsDirty = true;
+    m_linksDirty = true;
+    m_gridDirty = true;
 
     if (g_numWaypoints < 1)
         return;
@@ -1068,6 +1373,8 @@ void Waypoint::DeleteByIndex(int index)
     Path* path = nullptr;
     InternalAssert(m_paths[index] != nullptr);
 
+    RemoveWaypointFromMatrix(index);
+
     int i, j;
 
     for (i = 0; i < g_numWaypoints; i++) // delete all references to Node
@@ -1101,16 +1408,20 @@ void Waypoint::DeleteByIndex(int index)
     }
 
     // free deleted node
-    delete m_paths[index];
+    FreePath(m_paths[index]);
     m_paths[index] = nullptr;
 
     // Rotate Path Array down
     for (i = index; i < g_numWaypoints - 1; i++)
         m_paths[i] = m_paths[i + 1];
 
+    m_paths[g_numWaypoints - 1] = nullptr;
+
     g_numWaypoints--;
     m_waypointDisplayTime[index] = 0;
 
+    UpdatePathMatrix();
+
     PlaySound(g_hostEntity, "weapons/mine_activate.wav");
 }
 
@@ -1270,6 +1581,8 @@ void Waypoint::CreatePath(char dir)
 
     PlaySound(g_hostEntity, "common/wpn_hudon.wav");
     g_waypointsChanged = true;
+    m_componentsDirty = true;
+    m_linksDirty = true;
 }
 
 void Waypoint::TeleportWaypoint(void)
@@ -1311,12 +1624,18 @@ void Waypoint::DeletePath(void)
         if (m_paths[nodeFrom]->index[index] == nodeTo)
         {
             g_waypointsChanged = true;
+            m_componentsDirty = true;
+            m_linksDirty = true;
+
+            RemovePathFromMatrix(nodeFrom, nodeTo, m_paths[nodeFrom]->distances[index]);
 
             m_paths[nodeFrom]->index[index] = -1; // unassign this path
             m_paths[nodeFrom]->connectionFlags[index] = 0;
             m_paths[nodeFrom]->connectionVelocity[index] = nullvec;
             m_paths[nodeFrom]->distances[index] = 0;
 
+            UpdatePathMatrix();
+
             PlaySound(g_hostEntity, "weapons/mine_activate.wav");
             return;
         }
@@ -1332,12 +1651,18 @@ void Waypoint::DeletePath(void)
         if (m_paths[nodeFrom]->index[index] == nodeTo)
         {
             g_waypointsChanged = true;
+            m_componentsDirty = true;
+            m_linksDirty = true;
+
+            RemovePathFromMatrix(nodeFrom, nodeTo, m_paths[nodeFrom]->distances[index]);
 
             m_paths[nodeFrom]->index[index] = -1; // unassign this path
             m_paths[nodeFrom]->connectionFlags[index] = 0;
             m_paths[nodeFrom]->connectionVelocity[index] = nullvec;
             m_paths[nodeFrom]->distances[index] = 0;
 
+            UpdatePathMatrix();
+
             PlaySound(g_hostEntity, "weapons/mine_activate.wav");
             return;
         }
@@ -1505,122 +1830,453 @@ void Waypoint::InitTypes()
     }
 }
 
-bool Waypoint::Load(int mode)
+// this function labels the strongly connected components of the waypoint graph (tarjan) and
+// builds reachability between them, so unreachable goals are known before any search
+void Waypoint::InitComponents(void)
 {
-    WaypointHeader header;
-    File fp(CheckSubfolderFile(), "rb");
+    m_componentsDirty = false;
+    m_numComponents = 0;
+    m_numKeys = 0;
+    m_keyWords = 0;
+    m_keyReach.clear();
+    m_componentKey.clear();
+    m_component.resize(g_numWaypoints);
 
-    m_badMapName = false;
+    if (g_numWaypoints <= 0)
+        return;
 
-    if (fp.IsValid())
+    struct Frame
     {
-        fp.Read(&header, sizeof(header));
+        int index;
+        int child;
+    };
 
-        if (strncmp(header.header, FH_WAYPOINT_NEW, strlen(FH_WAYPOINT_NEW)) == 0 ||
-            strncmp(header.header, FH_WAYPOINT, strlen(FH_WAYPOINT)) == 0)
+    vector <int> order(g_numWaypoints, -1);
+    vector <int> lowLink(g_numWaypoints, 0);
+    vector <bool> onStack(g_numWaypoints, false);
+    vector <int> stack;
+    vector <Frame> callStack;
+
+    int counter = 0;
+
+    for (int start = 0; start < g_numWaypoints; start++)
+    {
+        if (order[start] != -1)
+            continue;
+
+        order[start] = lowLink[start] = counter++;
+        stack.push_back(start);
+        onStack[start] = true;
+        callStack.push_back({ start, 0 });
+
+        // no recursion, paths can be very deep on big maps
+        while (!callStack.empty())
         {
-            if (stricmp(header.mapName, GetMapName()) && mode == 0)
+            int index = callStack.back().index;
+
+            if (callStack.back().child < Const_MaxPathIndex)
             {
-                m_badMapName = true;
+                int next = m_paths[index]->index[callStack.back().child++];
+                if (!IsValidWaypoint(next))
+                    continue;
 
-                sprintf(m_infoBuffer, "%s - hacked waypoint file, fileName doesn't match waypoint header information (mapname: '%s', header: '%s')", GetMapName(), GetMapName(), header.mapName);
-                AddLogEntry(LOG_ERROR, m_infoBuffer);
+                if (order[next] == -1)
+                {
+                    order[next] = lowLink[next] = counter++;
+                    stack.push_back(next);
+                    onStack[next] = true;
+                    callStack.push_back({ next, 0 });
+                }
+                else if (onStack[next] && order[next] < lowLink[index])
+                    lowLink[index] = order[next];
 
-                fp.Close();
-                return false;
+                continue;
             }
-            else
-            {
-                Initialize();
-                g_numWaypoints = header.pointNumber;
 
-                for (int i = 0; i < g_numWaypoints; i++)
+            // root of the component, everything above it on the stack belongs to it
+            if (lowLink[index] == order[index])
+            {
+                int member;
+                do
                 {
-                    m_paths[i] = new Path;
-                    if (m_paths[i] == nullptr)
-                    {
-                        for (int j = 0; j < i; j++)
-                        {
-                            delete m_paths[i];
-                            m_paths[i] = nullptr;
-                        }
-                        g_numWaypoints = 0;
-                        m_waypointPaths = false;
-                        return false;
-                    }
-                    fp.Read(m_paths[i], sizeof(Path));
-                }
-                m_waypointPaths = true;
+                    member = stack.back();
+                    stack.pop_back();
+
+                    onStack[member] = false;
+                    m_component[member] = m_numComponents;
+                } while (member != index);
+
+                m_numComponents++;
             }
-        }
-        else
-        {
-            sprintf(m_infoBuffer, "%s is not a ebot waypoint file (header found '%s' needed '%s'", GetMapName(), header.header, FH_WAYPOINT);
-            AddLogEntry(LOG_ERROR, m_infoBuffer);
-            fp.Close();
-            return false;
-        }
 
-        fp.Close();
-    }
-    else
-    {
-        sprintf(m_infoBuffer, "%s does not exist, pleasue use 'ebot wp analyze' for create waypoints! (dont forget using 'ebot wp analyzeoff' when finished)", GetMapName());
-        AddLogEntry(LOG_ERROR, m_infoBuffer);
+            callStack.pop_back();
 
-        return false;
+            if (!callStack.empty() && lowLink[index] < lowLink[callStack.back().index])
+                lowLink[callStack.back().index] = lowLink[index];
+        }
     }
 
-    if (strncmp(header.author, "EfeDursun125", 12) == 0)
-        sprintf(m_infoBuffer, "Using Official Waypoint File By: %s", header.author);
-    else
-        sprintf(m_infoBuffer, "Using Waypoint File By: %s", header.author);
+    // components are found in reverse topological order, so every component a path leads to is already done.
+    // most components are single waypoints of one way links, only the others get a row and a column.
+    vector <int> members(g_numWaypoints);
+    vector <int> first(m_numComponents + 1, 0);
 
     for (int i = 0; i < g_numWaypoints; i++)
-        m_waypointDisplayTime[i] = 0.0f;
-
-    InitPathMatrix();
-    InitTypes();
+        first[m_component[i] + 1]++;
 
-    g_waypointsChanged = false;
-    g_killHistory = 0;
+    for (int i = 0; i < m_numComponents; i++)
+        first[i + 1] += first[i];
 
-    m_pathDisplayTime = 0.0f;
-    m_arrowDisplayTime = 0.0f;
+    vector <int> fill(first.begin(), first.end() - 1);
+    for (int i = 0; i < g_numWaypoints; i++)
+        members[fill[m_component[i]]++] = i;
 
-    g_exp.Load();
+    m_componentKey.assign(m_numComponents, -1);
 
-    g_botManager->InitQuota();
+    for (int component = 0; component < m_numComponents; component++)
+    {
+        if (first[component + 1] - first[component] > 1)
+            m_componentKey[component] = m_numKeys++;
+    }
 
-    extern ConVar ebot_debuggoal;
-    ebot_debuggoal.SetInt(-1);
+    m_keyWords = (m_numKeys + 31) / 32;
 
-    return true;
-}
+    // single waypoint components need their rows only until everything leading to them is done
+    vector <uint32_t> reachAll(m_numComponents * m_keyWords, 0);
 
-void Waypoint::Save(void)
-{
-    WaypointHeader header;
+    for (int component = 0; component < m_numComponents && m_keyWords > 0; component++)
+    {
+        uint32_t* reach = &reachAll[component * m_keyWords];
 
-    strcpy(header.header, FH_WAYPOINT);
-    strncpy(header.author, GetEntityName(g_hostEntity), sizeof(header.author)-1);
-    strncpy(header.mapName, GetMapName(), sizeof(header.mapName)-1);
-    header.fileVersion = FV_WAYPOINT;
-    header.pointNumber = g_numWaypoints;
+        int key = m_componentKey[component];
+        if (key != -1)
+            reach[key >> 5] |= 1u << (key & 31);
 
-    File fp(CheckSubfolderFile(), "wb");
+        for (int i = first[component]; i < first[component + 1]; i++)
+        {
+            Path* path = m_paths[members[i]];
 
-    // file was opened
-    if (fp.IsValid())
-    {
-        // write the waypoint header to the file...
-        fp.Write(&header, sizeof(header), 1);
+            for (int j = 0; j < Const_MaxPathIndex; j++)
+            {
+                if (!IsValidWaypoint(path->index[j]))
+                    continue;
 
-        // save the waypoint paths...
-        for (int i = 0; i < g_numWaypoints; i++)
-            fp.Write(m_paths[i], sizeof(Path));
+                int other = m_component[path->index[j]];
+                if (other == component)
+                    continue;
 
-        fp.Close();
+                const uint32_t* otherReach = &reachAll[other * m_keyWords];
+                for (int word = 0; word < m_keyWords; word++)
+                    reach[word] |= otherReach[word];
+            }
+        }
+    }
+
+    m_keyReach.assign(m_numKeys * m_keyWords, 0);
+
+    for (int component = 0; component < m_numComponents; component++)
+    {
+        int key = m_componentKey[component];
+        if (key != -1)
+            memcpy(&m_keyReach[key * m_keyWords], &reachAll[component * m_keyWords], m_keyWords * sizeof(uint32_t));
+    }
+
+    // incoming links, paths to a single waypoint are found by walking back from it
+    m_predFirst.assign(g_numWaypoints + 1, 0);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        for (int j = 0; j < Const_MaxPathIndex; j++)
+        {
+            if (IsValidWaypoint(m_paths[i]->index[j]))
+                m_predFirst[m_paths[i]->index[j] + 1]++;
+        }
+    }
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        m_predFirst[i + 1] += m_predFirst[i];
+
+    m_predIndex.resize(m_predFirst[g_numWaypoints]);
+    fill.assign(m_predFirst.begin(), m_predFirst.end() - 1);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        for (int j = 0; j < Const_MaxPathIndex; j++)
+        {
+            if (IsValidWaypoint(m_paths[i]->index[j]))
+                m_predIndex[fill[m_paths[i]->index[j]]++] = static_cast <int16> (i);
+        }
+    }
+
+    m_reachMark.assign(g_numWaypoints, 0);
+    m_reachStamp = 0;
+}
+
+// this function returns true if there is any path from srcIndex to destIndex
+bool Waypoint::IsReachable(int srcIndex, int destIndex)
+{
+    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
+        return false;
+
+    if (m_componentsDirty)
+        InitComponents();
+
+    int from = m_component[srcIndex];
+    int to = m_component[destIndex];
+
+    if (from == to)
+        return true;
+
+    // components are numbered in reverse topological order, links only lead to lower numbers
+    if (to > from)
+        return false;
+
+    int fromKey = m_componentKey[from];
+    int toKey = m_componentKey[to];
+
+    if (fromKey != -1 && toKey != -1)
+        return (m_keyReach[fromKey * m_keyWords + (toKey >> 5)] & (1u << (toKey & 31))) != 0;
+
+    // single waypoint on either end, walk over single waypoint components to the nearest key components.
+    // only components numbered between the ends can be on the way.
+    if (m_reachStamp >= 0xfffffff0u)
+    {
+        m_reachMark.assign(g_numWaypoints, 0);
+        m_reachStamp = 0;
+    }
+
+    // forward and backward walk mark the waypoints with their own stamp
+    m_reachStamp += 2;
+
+    const uint32_t forward = m_reachStamp - 1;
+    const uint32_t backward = m_reachStamp;
+
+    vector <int> sources, targets, stack;
+
+    if (fromKey != -1)
+        sources.push_back(fromKey);
+    else
+    {
+        stack.push_back(srcIndex);
+        m_reachMark[srcIndex] = forward;
+
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+
+            for (int j = 0; j < Const_MaxPathIndex; j++)
+            {
+                int next = m_paths[index]->index[j];
+                if (!IsValidWaypoint(next) || m_reachMark[next] == forward || m_component[next] < to)
+                    continue;
+
+                if (next == destIndex)
+                    return true;
+
+                m_reachMark[next] = forward;
+
+                if (m_componentKey[m_component[next]] != -1)
+                    sources.push_back(m_componentKey[m_component[next]]);
+                else
+                    stack.push_back(next);
+            }
+        }
+    }
+
+    if (toKey != -1)
+        targets.push_back(toKey);
+    else
+    {
+        stack.push_back(destIndex);
+
+        while (!stack.empty())
+        {
+            int index = stack.back();
+            stack.pop_back();
+
+            for (int i = m_predFirst[index]; i < m_predFirst[index + 1]; i++)
+            {
+                int prev = m_predIndex[i];
+                if (m_reachMark[prev] == backward || m_component[prev] > from)
+                    continue;
+
+                m_reachMark[prev] = backward;
+
+                if (m_componentKey[m_component[prev]] != -1)
+                    targets.push_back(m_componentKey[m_component[prev]]);
+                else
+                    stack.push_back(prev);
+            }
+        }
+    }
+
+    for (int source : sources)
+    {
+        for (int target : targets)
+        {
+            if (m_keyReach[source * m_keyWords + (target >> 5)] & (1u << (target & 31)))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool Waypoint::Load(int mode)
+{
+    WaypointHeader header;
+    File fp(CheckSubfolderFile(), "rb");
+
+    m_badMapName = false;
+
+    if (fp.IsValid())
+    {
+        fp.Read(&header, sizeof(header));
+
+        if (strncmp(header.header, FH_WAYPOINT_NEW, strlen(FH_WAYPOINT_NEW)) == 0 ||
+            strncmp(header.header, FH_WAYPOINT, strlen(FH_WAYPOINT)) == 0)
+        {
+            if (stricmp(header.mapName, GetMapName()) && mode == 0)
+            {
+                m_badMapName = true;
+
+                sprintf(m_infoBuffer, "%s - hacked waypoint file, fileName doesn't match waypoint header information (mapname: '%s', header: '%s')", GetMapName(), GetMapName(), header.mapName);
+                AddLogEntry(LOG_ERROR, m_infoBuffer);
+
+                fp.Close();
+                return false;
+            }
+            else
+            {
+                Initialize();
+
+                if (header.pointNumber < 0 || header.pointNumber > Const_MaxWaypoints)
+                {
+                    sprintf(m_infoBuffer, "%s - waypoint file has %d waypoints, maximum is %d", GetMapName(), header.pointNumber, Const_MaxWaypoints);
+                    AddLogEntry(LOG_ERROR, m_infoBuffer);
+
+                    fp.Close();
+                    return false;
+                }
+
+                g_numWaypoints = header.pointNumber;
+                ReserveWaypoints(g_numWaypoints);
+
+                // old files store the raw paths, newer ones are packed into sections
+                bool isPacked = header.fileVersion >= FV_WAYPOINT;
+
+                for (int i = 0; i < g_numWaypoints; i++)
+                {
+                    m_paths[i] = AllocPath();
+                    if (m_paths[i] == nullptr)
+                    {
+                        for (int j = 0; j < i; j++)
+                            m_paths[j] = nullptr;
+
+                        ResetPaths();
+                        g_numWaypoints = 0;
+                        m_waypointPaths = false;
+                        return false;
+                    }
+
+                    if (!isPacked)
+                        fp.Read(m_paths[i], sizeof(Path));
+                }
+                m_waypointPaths = true;
+
+                if (isPacked && !LoadSections(fp))
+                {
+                    sprintf(m_infoBuffer, "%s - waypoint file is corrupted", GetMapName());
+                    AddLogEntry(LOG_ERROR, m_infoBuffer);
+
+                    fp.Close();
+                    Initialize();
+                    m_waypointPaths = false;
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            sprintf(m_infoBuffer, "%s is not a ebot waypoint file (header found '%s' needed '%s'", GetMapName(), header.header, FH_WAYPOINT);
+            AddLogEntry(LOG_ERROR, m_infoBuffer);
+            fp.Close();
+            return false;
+        }
+
+        fp.Close();
+    }
+    else
+    {
+        sprintf(m_infoBuffer, "%s does not exist, pleasue use 'ebot wp analyze' for create waypoints! (dont forget using 'ebot wp analyzeoff' when finished)", GetMapName());
+        AddLogEntry(LOG_ERROR, m_infoBuffer);
+
+        return false;
+    }
+
+    if (strncmp(header.author, "EfeDursun125", 12) == 0)
+        sprintf(m_infoBuffer, "Using Official Waypoint File By: %s", header.author);
+    else
+        sprintf(m_infoBuffer, "Using Waypoint File By: %s", header.author);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        m_waypointDisplayTime[i] = 0.0f;
+
+    InitPathMatrix();
+    InitTypes();
+    InitGrid();
+    InitComponents();
+    UpdateLinks();
+    g_landmarks->Build();
+    g_pathClusters->Build();
+
+    InitializeVisibility();
+
+    g_pathCost->Reset(); // cached path costs belong to previous waypoints
+    g_pathCache->Clear();
+    g_waypointsChanged = false;
+    g_killHistory = 0;
+
+    m_pathDisplayTime = 0.0f;
+    m_arrowDisplayTime = 0.0f;
+
+    g_exp.Load();
+
+    g_botManager->InitQuota();
+
+    extern ConVar ebot_debuggoal;
+    ebot_debuggoal.SetInt(-1);
+
+    return true;
+}
+
+void Waypoint::Save(void)
+{
+    WaypointHeader header;
+
+    strcpy(header.header, FH_WAYPOINT);
+    strncpy(header.author, GetEntityName(g_hostEntity), sizeof(header.author)-1);
+    strncpy(header.mapName, GetMapName(), sizeof(header.mapName)-1);
+    header.fileVersion = FV_WAYPOINT;
+    header.pointNumber = g_numWaypoints;
+
+    // matrix is kept up to date while editing, so the next load doesn't have to build it
+    if (!m_matrixFile.IsValid())
+        SavePathMatrix();
+
+    File fp(CheckSubfolderFile(), "wb");
+
+    // file was opened
+    if (fp.IsValid())
+    {
+        // write the waypoint header to the file...
+        fp.Write(&header, sizeof(header), 1);
+
+        // save the waypoint paths...
+        SaveSections(fp);
+
+        fp.Close();
     }
     else
         AddLogEntry(LOG_ERROR, "Error writing '%s' waypoint file", GetMapName());
@@ -1910,15 +2566,69 @@ bool Waypoint::IsNodeReachableWithJump(Vector src, Vector destination, int flags
     return false;
 }
 
+// fnv-1a, used to check that saved tables belong to the loaded waypoints
+uint32_t HashBytes(uint32_t hash, const void* data, int size)
+{
+    const uint8_t* bytes = static_cast <const uint8_t*> (data);
+
+    for (int i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 void Waypoint::InitializeVisibility(void)
 {
-    if (m_redoneVisibility == false)
+    // this function loads the visibility table of the waypoints, or starts building it over the next frames
+
+    m_redoneVisibility = false;
+
+    // until its pair is traced, every waypoint is treated as not visible
+    m_visibilityWords = ((g_numWaypoints + 127) / 128) * 4;
+    m_visibilityNum = g_numWaypoints;
+
+    m_standVisibility.assign(m_visibilityNum * m_visibilityWords, 0);
+    m_crouchVisibility.assign(m_visibilityNum * m_visibilityWords, 0);
+
+    if (g_numWaypoints <= 0 || LoadVisibility())
+        return;
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        m_paths[i]->vis.crouch = 0;
+        m_paths[i]->vis.stand = 0;
+    }
+
+    m_visibilityIndex = 0;
+    m_visibilityColumn = 0;
+    m_redoneVisibility = true;
+}
+
+void Waypoint::ThinkVisibility(void)
+{
+    // this function traces a part of the visibility table every frame, so map loading doesn't freeze the server
+
+    if (!m_redoneVisibility)
         return;
 
+    // waypoints were added or removed meanwhile, start over
+    if (m_visibilityNum != g_numWaypoints)
+    {
+        InitializeVisibility();
+        return;
+    }
+
     TraceResult tr;
-    uint8_t res, shift;
+    uint8_t res;
 
-    for (m_visibilityIndex = 0; m_visibilityIndex < g_numWaypoints; m_visibilityIndex++)
+    // each pair needs two traces, from the ducked and the standing eye position of the source
+    int pairsLeft = ebot_visibility_traces.GetInt() / 2;
+    if (pairsLeft < 1)
+        pairsLeft = 1;
+
+    while (pairsLeft > 0 && m_visibilityIndex < g_numWaypoints)
     {
         Vector sourceDuck = m_paths[m_visibilityIndex]->origin;
         Vector sourceStand = m_paths[m_visibilityIndex]->origin;
@@ -1934,77 +2644,306 @@ void Waypoint::InitializeVisibility(void)
             sourceStand.z += 28.0f;
         }
 
-        uint16 standCount = 0, crouchCount = 0;
-
-        for (int i = 0; i < g_numWaypoints; i++)
+        for (; m_visibilityColumn < g_numWaypoints && pairsLeft > 0; m_visibilityColumn++)
         {
-            // first check ducked visibility
-            Vector dest = m_paths[i]->origin;
-
-            TraceLine(sourceDuck, dest, true, nullptr, &tr);
+            int i = m_visibilityColumn;
 
-            // check if line of sight to object is not blocked (i.e. visible)
-            if ((tr.flFraction != 1.0f) || tr.fStartSolid)
-                res = 1;
-            else
+            // traces go from the eyes of the source to the origin of the destination, so the table isn't
+            // symmetric, but a waypoint always sees itself
+            if (i == m_visibilityIndex)
                 res = 0;
+            else
+            {
+                pairsLeft--;
+
+                // first check ducked visibility
+                Vector dest = m_paths[i]->origin;
 
-            res <<= 1;
+                TraceLine(sourceDuck, dest, true, nullptr, &tr);
 
-            TraceLine(sourceStand, dest, true, nullptr, &tr);
+                // check if line of sight to object is not blocked (i.e. visible)
+                if ((tr.flFraction != 1.0f) || tr.fStartSolid)
+                    res = 1;
+                else
+                    res = 0;
+
+                res <<= 1;
 
-            // check if line of sight to object is not blocked (i.e. visible)
-            if ((tr.flFraction != 1.0f) || tr.fStartSolid)
-                res |= 1;
+                TraceLine(sourceStand, dest, true, nullptr, &tr);
+
+                // check if line of sight to object is not blocked (i.e. visible)
+                if ((tr.flFraction != 1.0f) || tr.fStartSolid)
+                    res |= 1;
+            }
 
-            shift = (i % 4) << 1;
-            m_visLUT[m_visibilityIndex][i >> 2] &= ~(3 << shift);
-            m_visLUT[m_visibilityIndex][i >> 2] |= res << shift;
+            uint32_t bit = 1u << (i & 31);
+            int word = m_visibilityIndex * m_visibilityWords + (i >> 5);
 
             if (!(res & 2))
-                crouchCount++;
+            {
+                m_crouchVisibility[word] |= bit;
+                m_paths[m_visibilityIndex]->vis.crouch++;
+            }
 
             if (!(res & 1))
-                standCount++;
+            {
+                m_standVisibility[word] |= bit;
+                m_paths[m_visibilityIndex]->vis.stand++;
+            }
         }
-        m_paths[m_visibilityIndex]->vis.crouch = crouchCount;
-        m_paths[m_visibilityIndex]->vis.stand = standCount;
+
+        if (m_visibilityColumn < g_numWaypoints)
+            return; // out of traces in the middle of the row
+
+        m_visibilityIndex++;
+        m_visibilityColumn = 0;
     }
 
+    if (m_visibilityIndex < g_numWaypoints)
+        return;
+
     m_redoneVisibility = false;
+    SaveVisibility();
+
+    ServerPrint("Visibility table is built for %d waypoints", g_numWaypoints);
 }
 
-bool Waypoint::IsVisible(int srcIndex, int destIndex)
+uint32_t Waypoint::GetVisibilityHash(void)
 {
-    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
-        return false;
+    // table depends only on the positions of the waypoints and where the eyes are on them
+    uint32_t hash = HashBytes(2166136261u, &g_numWaypoints, sizeof(int));
 
-    uint8_t res = m_visLUT[srcIndex][destIndex >> 2];
-    res >>= (destIndex % 4) << 1;
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        int32_t crouch = (m_paths[i]->flags & WAYPOINT_CROUCH) ? 1 : 0;
 
-    return !((res & 3) == 3);
+        hash = HashBytes(hash, &m_paths[i]->origin, sizeof(Vector));
+        hash = HashBytes(hash, &crouch, sizeof(int32_t));
+    }
+    return hash;
 }
 
-bool Waypoint::IsDuckVisible(int srcIndex, int destIndex)
+void Waypoint::SaveVisibility(void)
 {
-    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
+    if (g_numWaypoints <= 0 || m_redoneVisibility || m_visibilityNum != g_numWaypoints)
+        return;
+
+    File fp(FormatBuffer("%sdata/%s.vis", GetWaypointDir(), GetMapName()), "wb");
+
+    // unable to open file
+    if (!fp.IsValid())
+    {
+        AddLogEntry(LOG_ERROR, "Failed to open file for writing, waypoint/data folder isn't exits?");
+        return;
+    }
+
+    int tableSize = m_visibilityNum * m_visibilityWords;
+
+    VisTableHeader header;
+    memset(&header, 0, sizeof(header));
+
+    strcpy(header.header, FH_VISTABLE);
+    header.fileVersion = FV_VISTABLE;
+    header.pointNumber = g_numWaypoints;
+    header.pointHash = GetVisibilityHash();
+    header.dataHash = HashBytes(2166136261u, &m_standVisibility[0], tableSize * sizeof(uint32_t));
+    header.dataHash = HashBytes(header.dataHash, &m_crouchVisibility[0], tableSize * sizeof(uint32_t));
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        header.dataHash = HashBytes(header.dataHash, &m_paths[i]->vis, sizeof(Path::Vis_t));
+
+    fp.Write(&header, sizeof(header));
+    fp.Write(&m_standVisibility[0], sizeof(uint32_t), tableSize);
+    fp.Write(&m_crouchVisibility[0], sizeof(uint32_t), tableSize);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        fp.Write(&m_paths[i]->vis, sizeof(Path::Vis_t));
+
+    fp.Close();
+}
+
+bool Waypoint::LoadVisibility(void)
+{
+    char fileName[256];
+    sprintf(fileName, "%sdata/%s.vis", GetWaypointDir(), GetMapName());
+
+    File fp(fileName, "rb");
+
+    // file doesn't exists return false
+    if (!fp.IsValid())
+        return false;
+
+    int tableSize = m_visibilityNum * m_visibilityWords;
+    VisTableHeader header;
+
+    const char* error = nullptr;
+
+    if (fp.GetSize() != static_cast <int> (sizeof(header) + tableSize * 2 * sizeof(uint32_t) + g_numWaypoints * sizeof(Path::Vis_t)) || !fp.Read(&header, sizeof(header)))
+        error = "Visibility table file has wrong size";
+    else if (strncmp(header.header, FH_VISTABLE, sizeof(header.header)) != 0 || header.fileVersion != FV_VISTABLE)
+        error = "Visibility table file is outdated or corrupted";
+    else if (header.pointNumber != g_numWaypoints || header.pointHash != GetVisibilityHash())
+        error = "Visibility table file doesn't match the waypoints";
+    else
+    {
+        // counts are read into a copy first, rows are cleared again when the file is corrupted
+        vector <Path::Vis_t> counts(g_numWaypoints);
+
+        fp.Read(&m_standVisibility[0], sizeof(uint32_t), tableSize);
+        fp.Read(&m_crouchVisibility[0], sizeof(uint32_t), tableSize);
+        fp.Read(&counts[0], sizeof(Path::Vis_t), g_numWaypoints);
+
+        uint32_t dataHash = HashBytes(2166136261u, &m_standVisibility[0], tableSize * sizeof(uint32_t));
+        dataHash = HashBytes(dataHash, &m_crouchVisibility[0], tableSize * sizeof(uint32_t));
+
+        for (int i = 0; i < g_numWaypoints; i++)
+            dataHash = HashBytes(dataHash, &counts[i], sizeof(Path::Vis_t));
+
+        if (dataHash != header.dataHash)
+        {
+            error = "Visibility table file is corrupted";
+
+            m_standVisibility.assign(tableSize, 0);
+            m_crouchVisibility.assign(tableSize, 0);
+        }
+        else
+        {
+            for (int i = 0; i < g_numWaypoints; i++)
+                m_paths[i]->vis = counts[i];
+        }
+    }
+
+    fp.Close();
+
+    if (error != nullptr)
+    {
+        AddLogEntry(LOG_DEFAULT, "%s. Table will be rebuilded", error);
+        unlink(fileName);
+
+        return false;
+    }
+    return true;
+}
+
+bool Waypoint::IsVisible(int srcIndex, int destIndex)
+{
+    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex) || srcIndex >= m_visibilityNum || destIndex >= m_visibilityNum)
         return false;
 
-    uint8_t res = m_visLUT[srcIndex][destIndex >> 2];
-    res >>= (destIndex % 4) << 1;
+    int word = srcIndex * m_visibilityWords + (destIndex >> 5);
+    return ((m_standVisibility[word] | m_crouchVisibility[word]) & (1u << (destIndex & 31))) != 0;
+}
+
+bool Waypoint::IsDuckVisible(int srcIndex, int destIndex)
+{
+    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex) || srcIndex >= m_visibilityNum || destIndex >= m_visibilityNum)
+        return false;
 
-    return !((res & 2) == 2);
+    int word = srcIndex * m_visibilityWords + (destIndex >> 5);
+    return (m_crouchVisibility[word] & (1u << (destIndex & 31))) != 0;
 }
 
 bool Waypoint::IsStandVisible(int srcIndex, int destIndex)
 {
-    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
+    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex) || srcIndex >= m_visibilityNum || destIndex >= m_visibilityNum)
         return false;
 
-    uint8_t res = m_visLUT[srcIndex][destIndex >> 2];
-    res >>= (destIndex % 4) << 1;
+    int word = srcIndex * m_visibilityWords + (destIndex >> 5);
+    return (m_standVisibility[word] & (1u << (destIndex & 31))) != 0;
+}
+
+// loads 128 bits of the requested visibility rows
+static inline __m128i LoadVisibilityRow(const uint32_t* stand, const uint32_t* crouch, int rows, int word)
+{
+    __m128i result = _mm_setzero_si128();
+
+    if (rows & VISROW_STAND)
+        result = _mm_loadu_si128(reinterpret_cast <const __m128i*> (stand + word));
+
+    if (rows & VISROW_CROUCH)
+        result = _mm_or_si128(result, _mm_loadu_si128(reinterpret_cast <const __m128i*> (crouch + word)));
+
+    return result;
+}
+
+// counts set bits of 128 bits, popcnt isn't available on every cpu the server runs on
+static inline int CountBits(__m128i value)
+{
+    const __m128i mask1 = _mm_set1_epi8(0x55);
+    const __m128i mask2 = _mm_set1_epi8(0x33);
+    const __m128i mask4 = _mm_set1_epi8(0x0f);
+
+    value = _mm_sub_epi8(value, _mm_and_si128(_mm_srli_epi64(value, 1), mask1));
+    value = _mm_add_epi8(_mm_and_si128(value, mask2), _mm_and_si128(_mm_srli_epi64(value, 2), mask2));
+    value = _mm_and_si128(_mm_add_epi8(value, _mm_srli_epi64(value, 4)), mask4);
+    value = _mm_sad_epu8(value, _mm_setzero_si128()); // sum of the bytes in each half
+
+    return _mm_cvtsi128_si32(value) + _mm_cvtsi128_si32(_mm_srli_si128(value, 8));
+}
+
+void Waypoint::GetVisibleSet(int srcIndex, int rows, vector <uint32_t>& result)
+{
+    // this function returns a bitset of all waypoints visible from the source waypoint
+
+    result.assign(m_visibilityWords, 0);
+
+    if (!IsValidWaypoint(srcIndex) || srcIndex >= m_visibilityNum)
+        return;
+
+    const uint32_t* stand = &m_standVisibility[srcIndex * m_visibilityWords];
+    const uint32_t* crouch = &m_crouchVisibility[srcIndex * m_visibilityWords];
+
+    for (int i = 0; i < m_visibilityWords; i += 4)
+        _mm_storeu_si128(reinterpret_cast <__m128i*> (&result[i]), LoadVisibilityRow(stand, crouch, rows, i));
+}
+
+void Waypoint::GetVisibleExcept(int srcIndex, int hiddenIndex, int rows, vector <uint32_t>& result)
+{
+    // this function returns a bitset of waypoints visible from the source waypoint, but not from the hidden one
+
+    if (!IsValidWaypoint(hiddenIndex) || hiddenIndex >= m_visibilityNum)
+    {
+        GetVisibleSet(srcIndex, rows, result);
+        return;
+    }
+
+    result.assign(m_visibilityWords, 0);
+
+    if (!IsValidWaypoint(srcIndex) || srcIndex >= m_visibilityNum)
+        return;
+
+    const uint32_t* stand = &m_standVisibility[srcIndex * m_visibilityWords];
+    const uint32_t* crouch = &m_crouchVisibility[srcIndex * m_visibilityWords];
+    const uint32_t* hiddenStand = &m_standVisibility[hiddenIndex * m_visibilityWords];
+    const uint32_t* hiddenCrouch = &m_crouchVisibility[hiddenIndex * m_visibilityWords];
+
+    for (int i = 0; i < m_visibilityWords; i += 4)
+    {
+        __m128i visible = LoadVisibilityRow(stand, crouch, rows, i);
+        __m128i hidden = LoadVisibilityRow(hiddenStand, hiddenCrouch, rows, i);
+
+        _mm_storeu_si128(reinterpret_cast <__m128i*> (&result[i]), _mm_andnot_si128(hidden, visible));
+    }
+}
+
+int Waypoint::CountVisible(int srcIndex, const vector <uint32_t>& mask, int rows)
+{
+    // this function returns how many waypoints of the mask are visible from the source waypoint
+
+    if (!IsValidWaypoint(srcIndex) || srcIndex >= m_visibilityNum || static_cast <int> (mask.size()) < m_visibilityWords)
+        return 0;
+
+    const uint32_t* stand = &m_standVisibility[srcIndex * m_visibilityWords];
+    const uint32_t* crouch = &m_crouchVisibility[srcIndex * m_visibilityWords];
+
+    int count = 0;
 
-    return !((res & 1) == 1);
+    for (int i = 0; i < m_visibilityWords; i += 4)
+    {
+        __m128i candidates = _mm_loadu_si128(reinterpret_cast <const __m128i*> (&mask[i]));
+        count += CountBits(_mm_and_si128(LoadVisibilityRow(stand, crouch, rows, i), candidates));
+    }
+    return count;
 }
 
 // this function returns path information for waypoint pointed by id
@@ -2254,8 +3193,11 @@ void Waypoint::ShowWaypointMsg(void)
     float nearestDistance = FLT_MAX;
     int nearestIndex = -1;
 
-    // now iterate through all waypoints in a map, and draw required ones
-    for (int i = 0; i < g_numWaypoints; i++)
+    // now iterate through the waypoints around the host, and draw required ones
+    vector <int> nearby;
+    FindInGridRadius(GetEntityOrigin(g_hostEntity), 701.0f, nearby);
+
+    for (int i : nearby)
     {
         float distance = (m_paths[i]->origin - GetEntityOrigin(g_hostEntity)).GetLength();
 
@@ -2648,229 +3590,1158 @@ bool Waypoint::NodesValid(void)
                 ChartPrint("[SgdWP] Waypoint %d pathnumber differs from index!", i);
         }
 
-        if (m_paths[i]->flags & WAYPOINT_CAMP)
+        if (m_paths[i]->flags & WAYPOINT_CAMP)
+        {
+            if (m_paths[i]->campEndX == 0 && m_paths[i]->campEndY == 0)
+            { // try fix camp waypoints
+                m_paths[i]->campEndX = m_paths[i]->campStartX;
+                m_paths[i]->campEndY = m_paths[i]->campStartY;
+            }
+        }
+        else if (m_paths[i]->flags & WAYPOINT_TERRORIST)
+            terrPoints++;
+        else if (m_paths[i]->flags & WAYPOINT_COUNTER)
+            ctPoints++;
+        else if (m_paths[i]->flags & WAYPOINT_GOAL)
+            goalPoints++;
+        else if (m_paths[i]->flags & WAYPOINT_RESCUE)
+            rescuePoints++;
+
+        for (int k = 0; k < Const_MaxPathIndex; k++)
+        {
+            if (m_paths[i]->index[k] != -1)
+            {
+                if (m_paths[i]->index[k] >= g_numWaypoints || m_paths[i]->index[k] < -1)
+                {
+                    AddLogEntry(LOG_WARNING, "Waypoint %d - Pathindex %d out of Range!", i, k);
+                    (*g_engfuncs.pfnSetOrigin) (g_hostEntity, m_paths[i]->origin);
+
+                    g_waypointOn = true;
+                    g_editNoclip = true;
+
+                    haveError = true;
+                    if (g_sgdWaypoint)
+                        ChartPrint("[SgdWP] Waypoint %d - Pathindex %d out of Range!", i, k);
+                }
+                else if (m_paths[i]->index[k] == i)
+                {
+                    AddLogEntry(LOG_WARNING, "Waypoint %d - Pathindex %d points to itself!", i, k);
+                    (*g_engfuncs.pfnSetOrigin) (g_hostEntity, m_paths[i]->origin);
+
+                    g_waypointOn = true;
+                    g_editNoclip = true;
+
+                    haveError = true;
+                    if (g_sgdWaypoint)
+                        ChartPrint("[SgdWP] Waypoint %d - Pathindex %d points to itself!", i, k);
+                }
+            }
+        }
+    }
+
+    // areas that can't reach the rest of the map or can't be reached from it, only a warning since bots handle it
+    InitComponents();
+
+    if (m_numComponents > 1)
+    {
+        vector <int> size(m_numComponents, 0);
+        for (i = 0; i < g_numWaypoints; i++)
+            size[m_component[i]]++;
+
+        int mainComponent = 0;
+        for (i = 1; i < m_numComponents; i++)
+        {
+            if (size[i] > size[mainComponent])
+                mainComponent = i;
+        }
+
+        for (i = 0; i < g_numWaypoints; i++)
+        {
+            int component = m_component[i];
+            if (component == mainComponent || size[component] == 0)
+                continue;
+
+            AddLogEntry(LOG_WARNING, "Waypoint %d (and %d more) can't go to and come back from the main area!", i, size[component] - 1);
+            if (g_sgdWaypoint)
+                ChartPrint("[SgdWP] Waypoint %d (and %d more) can't go to and come back from the main area!", i, size[component] - 1);
+
+            size[component] = 0; // report every island once
+        }
+    }
+
+    if (g_mapType & MAP_CS && GetGameMode() == MODE_BASE)
+    {
+        if (rescuePoints == 0)
+        {
+            AddLogEntry(LOG_WARNING, "You didn't set a Rescue Point!");
+            haveError = true;
+            if (g_sgdWaypoint)
+                ChartPrint("[SgdWP] You didn't set a Rescue Point!");
+        }
+    }
+
+    if (terrPoints == 0 && GetGameMode() == MODE_BASE)
+    {
+        AddLogEntry(LOG_WARNING, "You didn't set any Terrorist Important Point!");
+        haveError = true;
+        if (g_sgdWaypoint)
+            ChartPrint("[SgdWP] You didn't set any Terrorist Important Point!");
+    }
+    else if (ctPoints == 0 && GetGameMode() == MODE_BASE)
+    {
+        AddLogEntry(LOG_WARNING, "You didn't set any CT Important Point!");
+        haveError = true;
+        if (g_sgdWaypoint)
+            ChartPrint("[SgdWP] You didn't set any CT Important Point!");
+    }
+    else if (goalPoints == 0 && GetGameMode() == MODE_BASE)
+    {
+        AddLogEntry(LOG_WARNING, "You didn't set any Goal Point!");
+        haveError = true;
+        if (g_sgdWaypoint)
+            ChartPrint("[SgdWP] You didn't set any Goal Point!");
+    }
+
+    CenterPrint("Waypoints are saved!");
+
+    return haveError ? false : true;
+}
+
+// floyd-warshall steps done in one pass over the matrix
+const int Const_MatrixSteps = 8;
+
+// this function applies steps k .. k + steps - 1 of floyd-warshall to the rows. a row only needs the pivot rows
+// as they were at their own step, so rows are independent and the result is same as the plain k, i, j loops
+static void RelaxMatrixRows(int* dist, int* path, int numWaypoints, int firstRow, int lastRow, int k, int steps, const int* pivots)
+{
+    int through[Const_MatrixSteps];
+    int nextHop[Const_MatrixSteps];
+
+    for (int i = firstRow; i < lastRow; i++)
+    {
+        int* rowDist = &dist[i * numWaypoints];
+        int* rowPath = &path[i * numWaypoints];
+
+        // values of the pivot columns at their own step
+        for (int s = 0; s < steps; s++)
+        {
+            int column = k + s;
+            int value = rowDist[column];
+            int hop = rowPath[column];
+
+            for (int t = 0; t < s; t++)
+            {
+                int candidate = through[t] + pivots[t * numWaypoints + column];
+                if (candidate < value)
+                {
+                    value = candidate;
+                    hop = nextHop[t];
+                }
+            }
+
+            through[s] = value;
+            nextHop[s] = hop;
+        }
+
+        int j = 0;
+
+        // four columns at once, all steps are applied while they're in registers
+        for (; j + 4 <= numWaypoints; j += 4)
+        {
+            __m128i distance = _mm_loadu_si128(reinterpret_cast <__m128i*> (&rowDist[j]));
+            __m128i hop = _mm_loadu_si128(reinterpret_cast <__m128i*> (&rowPath[j]));
+
+            for (int s = 0; s < steps; s++)
+            {
+                __m128i candidate = _mm_add_epi32(_mm_set1_epi32(through[s]), _mm_loadu_si128(reinterpret_cast <const __m128i*> (&pivots[s * numWaypoints + j])));
+                __m128i shorter = _mm_cmplt_epi32(candidate, distance);
+
+                distance = _mm_or_si128(_mm_and_si128(shorter, candidate), _mm_andnot_si128(shorter, distance));
+                hop = _mm_or_si128(_mm_and_si128(shorter, _mm_set1_epi32(nextHop[s])), _mm_andnot_si128(shorter, hop));
+            }
+
+            _mm_storeu_si128(reinterpret_cast <__m128i*> (&rowDist[j]), distance);
+            _mm_storeu_si128(reinterpret_cast <__m128i*> (&rowPath[j]), hop);
+        }
+
+        for (; j < numWaypoints; j++)
+        {
+            for (int s = 0; s < steps; s++)
+            {
+                int candidate = through[s] + pivots[s * numWaypoints + j];
+                if (candidate < rowDist[j])
+                {
+                    rowDist[j] = candidate;
+                    rowPath[j] = nextHop[s];
+                }
+            }
+        }
+    }
+}
+
+void Waypoint::InitPathMatrix(void)
+{
+    int i, j, k;
+
+    m_matrixFile.Close();
+    m_matrixBuffer.clear();
+    m_distMatrix = nullptr;
+    m_pathMatrix = nullptr;
+    m_distShift = 0;
+    m_matrixSize = 0;
+    m_matrixStride = 0;
+    m_matrixEditing = false;
+    m_matrixDirtyRows.clear();
+
+    if (g_numWaypoints <= 0)
+        return;
+
+    // matrices of so many waypoints don't fit well into the memory of the server, distances are estimated then
+    if (g_numWaypoints > Const_MaxMatrixWaypoints)
+    {
+        AddLogEntry(LOG_DEFAULT, "%d waypoints are too many for the path matrix (maximum is %d), using direct distances", g_numWaypoints, Const_MaxMatrixWaypoints);
+        return;
+    }
+
+    if (LoadPathMatrix())
+        return; // matrix loaded from file
+
+    // full precision matrices are only needed while building
+    vector <int> distMatrix;
+    vector <int> pathMatrix;
+    vector <int> pivots;
+
+    try
+    {
+        distMatrix.resize(g_numWaypoints * g_numWaypoints);
+        pathMatrix.resize(g_numWaypoints * g_numWaypoints);
+        pivots.resize(Const_MatrixSteps * g_numWaypoints);
+    }
+    catch (const bad_alloc&)
+    {
+        AddLogEntry(LOG_ERROR, "Not enough memory to build path matrix of %d waypoints, using direct distances", g_numWaypoints);
+        return;
+    }
+
+    for (i = 0; i < g_numWaypoints; i++)
+    {
+        for (j = 0; j < g_numWaypoints; j++)
+        {
+            if (i == j)
+            {
+                distMatrix[(i * g_numWaypoints) + i] = 0;
+                pathMatrix[(i * g_numWaypoints) + i] = -1;
+                continue;
+            }
+            distMatrix[i * g_numWaypoints + j] = 999999;
+            pathMatrix[i * g_numWaypoints + j] = -1;
+        }
+    }
+
+    for (i = 0; i < g_numWaypoints; i++)
+    {
+        for (j = 0; j < Const_MaxPathIndex; j++)
+        {
+            if (m_paths[i]->index[j] >= 0 && m_paths[i]->index[j] < g_numWaypoints)
+            {
+                distMatrix[(i * g_numWaypoints) + m_paths[i]->index[j]] = m_paths[i]->distances[j];
+                pathMatrix[(i * g_numWaypoints) + m_paths[i]->index[j]] = m_paths[i]->index[j];
+            }
+        }
+    }
+
+    // rows are split between the worker threads, each pass applies several steps
+    int numChunks = g_jobs->GetWorkersNum() + 1;
+    int rowsPerChunk = (g_numWaypoints + numChunks - 1) / numChunks;
+    int lastProgress = 0;
+
+    for (k = 0; k < g_numWaypoints; k += Const_MatrixSteps)
+    {
+        int steps = g_numWaypoints - k < Const_MatrixSteps ? g_numWaypoints - k : Const_MatrixSteps;
+
+        // pivot row of every step as it is at that step
+        for (i = 0; i < steps; i++)
+        {
+            int* pivot = &pivots[i * g_numWaypoints];
+            memcpy(pivot, &distMatrix[(k + i) * g_numWaypoints], g_numWaypoints * sizeof(int));
+
+            for (int t = 0; t < i; t++)
+            {
+                int through = pivot[k + t];
+                const int* other = &pivots[t * g_numWaypoints];
+
+                for (j = 0; j < g_numWaypoints; j++)
+                {
+                    if (through + other[j] < pivot[j])
+                        pivot[j] = through + other[j];
+                }
+            }
+        }
+
+        int* dist = &distMatrix[0];
+        int* path = &pathMatrix[0];
+        const int* pivotRows = &pivots[0];
+        int numWaypoints = g_numWaypoints;
+
+        for (int firstRow = 0; firstRow < g_numWaypoints; firstRow += rowsPerChunk)
+        {
+            int lastRow = firstRow + rowsPerChunk < g_numWaypoints ? firstRow + rowsPerChunk : g_numWaypoints;
+            g_jobs->Push("PathMatrix", [=] { RelaxMatrixRows(dist, path, numWaypoints, firstRow, lastRow, k, steps, pivotRows); }, JOB_PARALLEL);
+        }
+
+        g_jobs->Wait();
+
+        int progress = (k + steps) * 10 / g_numWaypoints;
+        if (progress > lastProgress)
+        {
+            lastProgress = progress;
+            ServerPrint("Building path matrix... %d%%", progress * 10);
+        }
+    }
+
+    // pick the smallest shift that lets the longest reachable distance fit into 16 bits
+    int numCells = g_numWaypoints * g_numWaypoints;
+    int maxDist = 0;
+
+    for (i = 0; i < numCells; i++)
+    {
+        if (distMatrix[i] < 999999 && distMatrix[i] > maxDist)
+            maxDist = distMatrix[i];
+    }
+
+    while ((maxDist >> m_distShift) >= 0xffff)
+        m_distShift++;
+
+    try
+    {
+        m_matrixBuffer.resize(numCells * 2);
+    }
+    catch (const bad_alloc&)
+    {
+        AddLogEntry(LOG_ERROR, "Not enough memory to keep path matrix of %d waypoints, using direct distances", g_numWaypoints);
+        m_distShift = 0;
+
+        return;
+    }
+
+    for (i = 0; i < numCells; i++)
+    {
+        m_matrixBuffer[i] = pathMatrix[i] < 0 ? 0xffff : static_cast <uint16> (pathMatrix[i]);
+        m_matrixBuffer[numCells + i] = distMatrix[i] >= 999999 ? 0xffff : static_cast <uint16> (distMatrix[i] >> m_distShift);
+    }
+
+    m_pathMatrix = &m_matrixBuffer[0];
+    m_distMatrix = &m_matrixBuffer[numCells];
+    m_matrixSize = g_numWaypoints;
+    m_matrixStride = g_numWaypoints;
+    m_matrixEditing = false;
+
+    // save path matrix to file for faster access, and map it back so the pages are shared
+    SavePathMatrix();
+
+    if (LoadPathMatrix())
+    {
+        m_matrixBuffer.clear();
+        m_matrixBuffer.shrink_to_fit();
+    }
+}
+
+uint32_t Waypoint::GetGraphHash(void)
+{
+    // any change to the waypoint links invalidates the saved matrix
+    uint32_t hash = HashBytes(2166136261u, &g_numWaypoints, sizeof(int));
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        for (int j = 0; j < Const_MaxPathIndex; j++)
+        {
+            int32_t index = m_paths[i]->index[j];
+            int32_t distance = m_paths[i]->distances[j];
+
+            hash = HashBytes(hash, &index, sizeof(int32_t));
+            hash = HashBytes(hash, &distance, sizeof(int32_t));
+        }
+    }
+    return hash;
+}
+
+// this function checks that the packed .vis or .pmt file belongs to the current waypoints
+bool Waypoint::IsPackedTableValid(int section, const vector <uint8_t>& data)
+{
+    if (section == WPSECTION_VISIBILITY)
+    {
+        if (data.size() < sizeof(VisTableHeader))
+            return false;
+
+        const VisTableHeader* header = reinterpret_cast <const VisTableHeader*> (data.data());
+        return strncmp(header->header, FH_VISTABLE, sizeof(header->header)) == 0 && header->fileVersion == FV_VISTABLE && header->pointNumber == g_numWaypoints && header->pointHash == GetVisibilityHash();
+    }
+
+    if (data.size() < sizeof(PathMatrixHeader))
+        return false;
+
+    const PathMatrixHeader* header = reinterpret_cast <const PathMatrixHeader*> (data.data());
+    return strncmp(header->header, FH_PATHMATRIX, sizeof(header->header)) == 0 && header->fileVersion == FV_PATHMATRIX && header->pointNumber == g_numWaypoints && header->graphHash == GetGraphHash();
+}
+
+static bool ReadTableFile(const char* fileName, vector <uint8_t>& data)
+{
+    File fp(fileName, "rb");
+
+    if (!fp.IsValid() || fp.GetSize() <= 0)
+        return false;
+
+    data.resize(fp.GetSize());
+    return fp.Read(data.data(), data.size());
+}
+
+// this function writes the unpacked table for its loader, unless the same table is there already
+static void WriteTableFile(const char* fileName, const vector <uint8_t>& data, int headerSize)
+{
+    File fp(fileName, "rb");
+
+    if (fp.IsValid() && fp.GetSize() == static_cast <int> (data.size()))
+    {
+        vector <uint8_t> header(headerSize);
+
+        if (fp.Read(header.data(), headerSize) && memcmp(header.data(), data.data(), headerSize) == 0)
+            return;
+    }
+
+    fp.Close();
+
+    if (!fp.Open(fileName, "wb"))
+    {
+        AddLogEntry(LOG_ERROR, "Failed to open file for writing, waypoint/data folder isn't exits?");
+        return;
+    }
+
+    fp.Write(const_cast <uint8_t*> (data.data()), data.size());
+    fp.Close();
+}
+
+static bool WriteSection(File& fp, int type, const void* data, int size)
+{
+    WaypointSectionHeader section;
+
+    section.type = type;
+    section.rawSize = size;
+    section.packedSize = 0;
+    section.dataHash = HashBytes(2166136261u, data, size);
+
+    if (!fp.Write(&section, sizeof(section)))
+        return false;
+
+    Compressor compressor;
+    section.packedSize = compressor.EncodeStream(fp, static_cast <const uint8_t*> (data), size);
+
+    if (section.packedSize < 0)
+        return false;
+
+    // packed size is known only now, so write the header again
+    fp.Seek(-static_cast <long> (section.packedSize + sizeof(section)), SEEK_CUR);
+    fp.Write(&section, sizeof(section));
+    fp.Seek(0, SEEK_END);
+
+    return true;
+}
+
+void Waypoint::SaveSections(File& fp)
+{
+    // nodes and connections are split, so alike data is packed together
+    vector <WaypointNodeRecord> nodes(g_numWaypoints);
+    vector <WaypointLinkRecord> links(g_numWaypoints);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        const Path* path = m_paths[i];
+        WaypointNodeRecord& node = nodes[i];
+
+        node.flags = path->flags;
+        node.origin = path->origin;
+        node.radius = path->radius;
+        node.campStartX = path->campStartX;
+        node.campStartY = path->campStartY;
+        node.campEndX = path->campEndX;
+        node.campEndY = path->campEndY;
+
+        memcpy(links[i].index, path->index, sizeof(path->index));
+        memcpy(links[i].connectionFlags, path->connectionFlags, sizeof(path->connectionFlags));
+        memcpy(links[i].connectionVelocity, path->connectionVelocity, sizeof(path->connectionVelocity));
+        memcpy(links[i].distances, path->distances, sizeof(path->distances));
+    }
+
+    // tables are packed too, so servers don't have to build them after getting the waypoint file
+    vector <uint8_t> visibility, matrix;
+
+    if (ebot_waypoint_pack_tables.GetBool())
+    {
+        char fileName[256];
+
+        sprintf(fileName, "%sdata/%s.vis", GetWaypointDir(), GetMapName());
+        if (!ReadTableFile(fileName, visibility) || !IsPackedTableValid(WPSECTION_VISIBILITY, visibility))
+            visibility.clear();
+
+        sprintf(fileName, "%sdata/%s.pmt", GetWaypointDir(), GetMapName());
+        if (!ReadTableFile(fileName, matrix) || !IsPackedTableValid(WPSECTION_MATRIX, matrix))
+            matrix.clear();
+    }
+
+    WaypointPackHeader pack;
+    pack.graphHash = GetGraphHash();
+    pack.numSections = 2 + (visibility.empty() ? 0 : 1) + (matrix.empty() ? 0 : 1);
+
+    bool written = fp.Write(&pack, sizeof(pack));
+    written = written && WriteSection(fp, WPSECTION_NODES, nodes.data(), g_numWaypoints * sizeof(WaypointNodeRecord));
+    written = written && WriteSection(fp, WPSECTION_CONNECTIONS, links.data(), g_numWaypoints * sizeof(WaypointLinkRecord));
+
+    if (!visibility.empty())
+        written = written && WriteSection(fp, WPSECTION_VISIBILITY, visibility.data(), visibility.size());
+
+    if (!matrix.empty())
+        written = written && WriteSection(fp, WPSECTION_MATRIX, matrix.data(), matrix.size());
+
+    if (!written)
+        AddLogEntry(LOG_ERROR, "Error writing '%s' waypoint file", GetMapName());
+}
+
+bool Waypoint::LoadSections(File& fp)
+{
+    WaypointPackHeader pack;
+
+    if (!fp.Read(&pack, sizeof(pack)) || pack.numSections < 0)
+        return false;
+
+    bool hasNodes = false, hasLinks = false;
+    vector <uint8_t> data, visibility, matrix;
+    Compressor compressor;
+
+    for (int i = 0; i < pack.numSections; i++)
+    {
+        WaypointSectionHeader section;
+
+        if (!fp.Read(&section, sizeof(section)) || section.rawSize < 0 || section.packedSize < 0 || section.packedSize > fp.GetSize())
+            return false;
+
+        vector <uint8_t>* target = &data;
+
+        if (section.type == WPSECTION_NODES)
+        {
+            if (section.rawSize != static_cast <int> (g_numWaypoints * sizeof(WaypointNodeRecord)))
+                return false;
+        }
+        else if (section.type == WPSECTION_CONNECTIONS)
+        {
+            if (section.rawSize != static_cast <int> (g_numWaypoints * sizeof(WaypointLinkRecord)))
+                return false;
+        }
+        else if (section.type == WPSECTION_VISIBILITY || section.type == WPSECTION_MATRIX)
+        {
+            // tables are rebuilded if missing, so one of wrong size is skipped before anything is allocated for it
+            int64_t tableSize;
+
+            if (section.type == WPSECTION_VISIBILITY)
+            {
+                int64_t words = ((g_numWaypoints + 127) / 128) * 4;
+                tableSize = sizeof(VisTableHeader) + static_cast <int64_t> (g_numWaypoints) * words * 2 * sizeof(uint32_t) + g_numWaypoints * sizeof(Path::Vis_t);
+                target = &visibility;
+            }
+            else
+            {
+                tableSize = sizeof(PathMatrixHeader) + static_cast <int64_t> (g_numWaypoints) * g_numWaypoints * 2 * sizeof(uint16);
+                target = &matrix;
+            }
+
+            if (section.rawSize != tableSize)
+            {
+                fp.Seek(section.packedSize, SEEK_CUR);
+                continue;
+            }
+        }
+        else
+        {
+            // section from a newer version, skip it
+            fp.Seek(section.packedSize, SEEK_CUR);
+            continue;
+        }
+
+        target->resize(section.rawSize);
+
+        if (compressor.DecodeStream(fp, section.packedSize, target->data(), section.rawSize) != section.rawSize || HashBytes(2166136261u, target->data(), section.rawSize) != section.dataHash)
+            return false;
+
+        if (section.type == WPSECTION_NODES)
+        {
+            const WaypointNodeRecord* nodes = reinterpret_cast <const WaypointNodeRecord*> (data.data());
+
+            for (int j = 0; j < g_numWaypoints; j++)
+            {
+                Path* path = m_paths[j];
+
+                path->pathNumber = j;
+                path->flags = nodes[j].flags;
+                path->origin = nodes[j].origin;
+                path->radius = nodes[j].radius;
+                path->campStartX = nodes[j].campStartX;
+                path->campStartY = nodes[j].campStartY;
+                path->campEndX = nodes[j].campEndX;
+                path->campEndY = nodes[j].campEndY;
+            }
+
+            hasNodes = true;
+        }
+        else if (section.type == WPSECTION_CONNECTIONS)
+        {
+            const WaypointLinkRecord* links = reinterpret_cast <const WaypointLinkRecord*> (data.data());
+
+            for (int j = 0; j < g_numWaypoints; j++)
+            {
+                Path* path = m_paths[j];
+
+                memcpy(path->index, links[j].index, sizeof(path->index));
+                memcpy(path->connectionFlags, links[j].connectionFlags, sizeof(path->connectionFlags));
+                memcpy(path->connectionVelocity, links[j].connectionVelocity, sizeof(path->connectionVelocity));
+                memcpy(path->distances, links[j].distances, sizeof(path->distances));
+            }
+
+            hasLinks = true;
+        }
+    }
+
+    if (!hasNodes || !hasLinks || pack.graphHash != GetGraphHash())
+        return false;
+
+    // packed tables go where their loaders look for them
+    char fileName[256];
+
+    if (!visibility.empty() && IsPackedTableValid(WPSECTION_VISIBILITY, visibility))
+    {
+        sprintf(fileName, "%sdata/%s.vis", GetWaypointDir(), GetMapName());
+        WriteTableFile(fileName, visibility, sizeof(VisTableHeader));
+    }
+
+    if (!matrix.empty() && IsPackedTableValid(WPSECTION_MATRIX, matrix))
+    {
+        sprintf(fileName, "%sdata/%s.pmt", GetWaypointDir(), GetMapName());
+        WriteTableFile(fileName, matrix, sizeof(PathMatrixHeader));
+    }
+
+    return true;
+}
+
+void Waypoint::SavePathMatrix(void)
+{
+    if (m_pathMatrix == nullptr || m_distMatrix == nullptr || m_matrixSize != g_numWaypoints)
+        return;
+
+    char fileName[256], tempName[256];
+    sprintf(fileName, "%sdata/%s.pmt", GetWaypointDir(), GetMapName());
+
+    // other servers may have the file mapped, so it's written aside and replaced as a whole
+    sprintf(tempName, "%s.%d", fileName, Engine::GetReference()->RandomInt(0, 99999));
+
+    File fp(tempName, "wb");
+
+    // unable to open file
+    if (!fp.IsValid())
+    {
+        AddLogEntry(LOG_FATAL, "Failed to open file for writing, waypoint/data folder isn't exits?");
+        return;
+    }
+
+    PathMatrixHeader header;
+    memset(&header, 0, sizeof(header));
+
+    strcpy(header.header, FH_PATHMATRIX);
+    header.fileVersion = FV_PATHMATRIX;
+    header.pointNumber = g_numWaypoints;
+    header.graphHash = GetGraphHash();
+    header.distanceShift = m_distShift;
+
+    fp.Write(&header, sizeof(header));
+
+    // write path & distance matrix, edited matrices have longer rows than the file
+    for (int i = 0; i < g_numWaypoints; i++)
+        fp.Write(const_cast <uint16*> (m_pathMatrix + i * m_matrixStride), sizeof(uint16), g_numWaypoints);
+
+    for (int i = 0; i < g_numWaypoints; i++)
+        fp.Write(const_cast <uint16*> (m_distMatrix + i * m_matrixStride), sizeof(uint16), g_numWaypoints);
+
+    // and close the file
+    fp.Close();
+
+    // windows can't rename over the file, and can't remove it either while it's mapped
+    if (rename(tempName, fileName) != 0)
+    {
+        remove(fileName);
+
+        if (rename(tempName, fileName) != 0)
+            remove(tempName);
+    }
+}
+
+bool Waypoint::LoadPathMatrix(void)
+{
+    char fileName[256];
+    sprintf(fileName, "%sdata/%s.pmt", GetWaypointDir(), GetMapName());
+
+    // file doesn't exists return false
+    if (!m_matrixFile.Open(fileName))
+        return false;
+
+    int numCells = g_numWaypoints * g_numWaypoints;
+    const PathMatrixHeader* header = static_cast <const PathMatrixHeader*> (m_matrixFile.GetData());
+
+    const char* error = nullptr;
+
+    if (m_matrixFile.GetSize() < static_cast <int> (sizeof(PathMatrixHeader)) || strncmp(header->header, FH_PATHMATRIX, sizeof(header->header)) != 0 || header->fileVersion != FV_PATHMATRIX)
+        error = "Path matrix file is outdated or corrupted";
+    else if (header->pointNumber != g_numWaypoints)
+        error = "Wrong number of points in path matrix file";
+    else if (header->graphHash != GetGraphHash())
+        error = "Path matrix file doesn't match the waypoint links";
+    else if (m_matrixFile.GetSize() != static_cast <int> (sizeof(PathMatrixHeader) + numCells * 2 * sizeof(uint16)) || header->distanceShift < 0 || header->distanceShift > 15)
+        error = "Path matrix file has wrong size";
+
+    if (error != nullptr)
+    {
+        // file is replaced when the rebuilded matrix is saved, other servers may still use it
+        AddLogEntry(LOG_DEFAULT, "%s. Matrix will be rebuilded", error);
+        m_matrixFile.Close();
+
+        return false;
+    }
+
+    // matrices are used straight from the mapped file
+    m_distShift = header->distanceShift;
+    m_pathMatrix = reinterpret_cast <const uint16*> (header + 1);
+    m_distMatrix = m_pathMatrix + numCells;
+    m_matrixSize = g_numWaypoints;
+    m_matrixStride = g_numWaypoints;
+    m_matrixEditing = false;
+
+    return true;
+}
+
+int Waypoint::GetNextHop(int srcIndex, int destIndex)
+{
+    if (m_pathMatrix == nullptr || !IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
+        return -1;
+
+    // waypoint added after the last matrix update, it isn't connected yet
+    if (srcIndex >= m_matrixSize || destIndex >= m_matrixSize)
+        return -1;
+
+    uint16 next = m_pathMatrix[(srcIndex * m_matrixStride) + destIndex];
+    return next == 0xffff ? -1 : next;
+}
+
+int Waypoint::GetPathDistance(int srcIndex, int destIndex)
+{
+    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
+        return 9999;
+
+    // no matrix for this map, straight distance is the best guess
+    if (m_distMatrix == nullptr)
+        return static_cast <int> ((m_paths[srcIndex]->origin - m_paths[destIndex]->origin).GetLength());
+
+    if (srcIndex >= m_matrixSize || destIndex >= m_matrixSize)
+        return srcIndex == destIndex ? 0 : 999999;
+
+    uint16 dist = m_distMatrix[(srcIndex * m_matrixStride) + destIndex];
+    return dist == 0xffff ? 999999 : (dist << m_distShift);
+}
+
+const int Const_MatrixEditSlack = 256;
+
+bool Waypoint::PrepareMatrixEdit(void)
+{
+    // edits work on a private copy with room for some more waypoints, so new waypoints rarely move the rows.
+    // cells outside the covered waypoints are always kept unreachable.
+
+    int i;
+
+    // map has too many waypoints for a matrix, nothing to edit
+    if (g_numWaypoints > Const_MaxMatrixWaypoints)
+    {
+        if (m_matrixSize > 0)
+            InitPathMatrix();
+
+        return false;
+    }
+
+    if (!m_matrixEditing || m_matrixStride < g_numWaypoints)
+    {
+        int stride = g_numWaypoints + Const_MatrixEditSlack;
+        if (stride > Const_MaxMatrixWaypoints)
+            stride = Const_MaxMatrixWaypoints;
+
+        bool hadMatrix = m_pathMatrix != nullptr;
+
+        vector <uint16> buffer;
+
+        try
         {
-            if (m_paths[i]->campEndX == 0 && m_paths[i]->campEndY == 0)
-            { // try fix camp waypoints
-                m_paths[i]->campEndX = m_paths[i]->campStartX;
-                m_paths[i]->campEndY = m_paths[i]->campStartY;
-            }
+            buffer.assign(stride * stride * 2, 0xffff);
+        }
+        catch (const bad_alloc&)
+        {
+            // old matrix stays as it was, waypoints added since then aren't covered by it
+            AddLogEntry(LOG_ERROR, "Not enough memory to edit path matrix of %d waypoints", g_numWaypoints);
+            return m_matrixEditing && m_matrixSize > 0;
         }
-        else if (m_paths[i]->flags & WAYPOINT_TERRORIST)
-            terrPoints++;
-        else if (m_paths[i]->flags & WAYPOINT_COUNTER)
-            ctPoints++;
-        else if (m_paths[i]->flags & WAYPOINT_GOAL)
-            goalPoints++;
-        else if (m_paths[i]->flags & WAYPOINT_RESCUE)
-            rescuePoints++;
 
-        for (int k = 0; k < Const_MaxPathIndex; k++)
+        if (!hadMatrix)
+            m_matrixSize = 0;
+
+        for (i = 0; i < m_matrixSize; i++)
         {
-            if (m_paths[i]->index[k] != -1)
-            {
-                if (m_paths[i]->index[k] >= g_numWaypoints || m_paths[i]->index[k] < -1)
-                {
-                    AddLogEntry(LOG_WARNING, "Waypoint %d - Pathindex %d out of Range!", i, k);
-                    (*g_engfuncs.pfnSetOrigin) (g_hostEntity, m_paths[i]->origin);
+            memcpy(&buffer[i * stride], m_pathMatrix + i * m_matrixStride, m_matrixSize * sizeof(uint16));
+            memcpy(&buffer[stride * stride + i * stride], m_distMatrix + i * m_matrixStride, m_matrixSize * sizeof(uint16));
+        }
 
-                    g_waypointOn = true;
-                    g_editNoclip = true;
+        m_matrixFile.Close();
+        m_matrixBuffer.swap(buffer);
 
-                    haveError = true;
-                    if (g_sgdWaypoint)
-                        ChartPrint("[SgdWP] Waypoint %d - Pathindex %d out of Range!", i, k);
-                }
-                else if (m_paths[i]->index[k] == i)
-                {
-                    AddLogEntry(LOG_WARNING, "Waypoint %d - Pathindex %d points to itself!", i, k);
-                    (*g_engfuncs.pfnSetOrigin) (g_hostEntity, m_paths[i]->origin);
+        // rows marked while growing the copy are still dirty
+        if (!m_matrixEditing)
+            m_matrixDirtyRows.clear();
 
-                    g_waypointOn = true;
-                    g_editNoclip = true;
+        m_matrixStride = stride;
+        m_matrixEditing = true;
+        m_matrixDirtyRows.resize(stride, 0);
 
-                    haveError = true;
-                    if (g_sgdWaypoint)
-                        ChartPrint("[SgdWP] Waypoint %d - Pathindex %d points to itself!", i, k);
-                }
+        m_pathMatrix = &m_matrixBuffer[0];
+        m_distMatrix = &m_matrixBuffer[stride * stride];
+
+        // nothing is known about waypoints that existed before the matrix, search them all
+        if (!hadMatrix && g_numWaypoints > 0)
+        {
+            for (i = 0; i < g_numWaypoints; i++)
+            {
+                m_matrixBuffer[stride * stride + i * stride + i] = 0;
+                m_matrixDirtyRows[i] = 1;
             }
+
+            m_matrixSize = g_numWaypoints;
+            UpdatePathMatrix();
         }
     }
 
-    if (g_mapType & MAP_CS && GetGameMode() == MODE_BASE)
+    // new waypoints start without any connection
+    for (i = m_matrixSize; i < g_numWaypoints; i++)
+        m_matrixBuffer[m_matrixStride * m_matrixStride + i * m_matrixStride + i] = 0;
+
+    if (m_matrixSize < g_numWaypoints)
+        m_matrixSize = g_numWaypoints;
+
+    return m_matrixSize > 0;
+}
+
+void Waypoint::FitDistanceShift(int maxDist)
+{
+    // edit made a path longer than the stored distances can hold, halve all of them instead of clamping
+
+    const int stride = m_matrixStride;
+    uint16* dist = &m_matrixBuffer[stride * stride];
+
+    while ((maxDist >> m_distShift) >= 0xfffe && m_distShift < 15)
     {
-        if (rescuePoints == 0)
+        for (int i = 0; i < m_matrixSize; i++)
         {
-            AddLogEntry(LOG_WARNING, "You didn't set a Rescue Point!");
-            haveError = true;
-            if (g_sgdWaypoint)
-                ChartPrint("[SgdWP] You didn't set a Rescue Point!");
+            for (int j = 0; j < m_matrixSize; j++)
+            {
+                if (dist[i * stride + j] != 0xffff)
+                    dist[i * stride + j] >>= 1;
+            }
         }
+
+        m_distShift++;
     }
+}
 
-    if (terrPoints == 0 && GetGameMode() == MODE_BASE)
+void Waypoint::AddPathToMatrix(int srcIndex, int destIndex, int distance)
+{
+    // new connection only shortens paths, so relax every pair through it. rows that can't reach the
+    // connection cheaper than before and columns it doesn't bring closer are skipped.
+
+    if (!PrepareMatrixEdit() || srcIndex >= m_matrixSize || destIndex >= m_matrixSize)
+        return;
+
+    const int stride = m_matrixStride;
+    uint16* path = &m_matrixBuffer[0];
+    uint16* dist = &m_matrixBuffer[stride * stride];
+
+    auto decode = [this](uint16 value) { return value == 0xffff ? 999999 : (value << m_distShift); };
+    auto encode = [this](int value) { return static_cast <uint16> ((value >> m_distShift) < 0xfffe ? (value >> m_distShift) : 0xfffe); };
+
+    if (decode(dist[srcIndex * stride + destIndex]) <= distance)
+        return;
+
+    vector <int> columns;
+    vector <int> columnDist;
+
+    for (int j = 0; j < m_matrixSize; j++)
     {
-        AddLogEntry(LOG_WARNING, "You didn't set any Terrorist Important Point!");
-        haveError = true;
-        if (g_sgdWaypoint)
-            ChartPrint("[SgdWP] You didn't set any Terrorist Important Point!");
+        int fromDest = decode(dist[destIndex * stride + j]);
+
+        if (fromDest < 999999 && distance + fromDest < decode(dist[srcIndex * stride + j]))
+        {
+            columns.push_back(j);
+            columnDist.push_back(distance + fromDest);
+        }
     }
-    else if (ctPoints == 0 && GetGameMode() == MODE_BASE)
+
+    // longest path the connection can make, the encoding must fit it before anything is written
+    int maxColumn = 0, maxToSrc = 0;
+
+    for (size_t c = 0; c < columns.size(); c++)
+        maxColumn = columnDist[c] > maxColumn ? columnDist[c] : maxColumn;
+
+    for (int i = 0; i < m_matrixSize; i++)
     {
-        AddLogEntry(LOG_WARNING, "You didn't set any CT Important Point!");
-        haveError = true;
-        if (g_sgdWaypoint)
-            ChartPrint("[SgdWP] You didn't set any CT Important Point!");
+        int toSrc = decode(dist[i * stride + srcIndex]);
+        if (toSrc < 999999 && toSrc > maxToSrc)
+            maxToSrc = toSrc;
     }
-    else if (goalPoints == 0 && GetGameMode() == MODE_BASE)
+
+    FitDistanceShift(maxToSrc + maxColumn);
+
+    for (int i = 0; i < m_matrixSize; i++)
     {
-        AddLogEntry(LOG_WARNING, "You didn't set any Goal Point!");
-        haveError = true;
-        if (g_sgdWaypoint)
-            ChartPrint("[SgdWP] You didn't set any Goal Point!");
-    }
+        int toSrc = decode(dist[i * stride + srcIndex]);
 
-    CenterPrint("Waypoints are saved!");
+        if (toSrc >= 999999 || toSrc + distance >= decode(dist[i * stride + destIndex]))
+            continue;
 
-    return haveError ? false : true;
+        uint16 nextHop = i == srcIndex ? static_cast <uint16> (destIndex) : path[i * stride + srcIndex];
+
+        for (size_t c = 0; c < columns.size(); c++)
+        {
+            int j = columns[c];
+            int candidate = toSrc + columnDist[c];
+
+            if (candidate < decode(dist[i * stride + j]))
+            {
+                dist[i * stride + j] = encode(candidate);
+                path[i * stride + j] = nextHop;
+            }
+        }
+    }
 }
 
-void Waypoint::InitPathMatrix(void)
+void Waypoint::RemovePathFromMatrix(int srcIndex, int destIndex, int distance)
 {
-    int i, j, k;
+    // must be called before the connection is removed. only rows with a shortest path through it
+    // are affected, they are searched again by UpdatePathMatrix once the waypoints are changed.
 
-    if (m_distMatrix != nullptr)
-    {
-        delete[](m_distMatrix);
-        m_distMatrix = nullptr;
-    }
+    if (!PrepareMatrixEdit() || srcIndex >= m_matrixSize || destIndex >= m_matrixSize)
+        return;
+
+    const int stride = m_matrixStride;
+    const uint16* dist = &m_matrixBuffer[stride * stride];
+
+    auto decode = [this](uint16 value) { return value == 0xffff ? 999999 : (value << m_distShift); };
 
-    if (m_pathMatrix != nullptr)
+    // stored distances are rounded when shifted, so compare with some slack
+    int slack = m_distShift > 0 ? (2 << m_distShift) : 0;
+
+    if (decode(dist[srcIndex * stride + destIndex]) + slack < distance)
+        return; // there is a shorter way around, connection isn't used
+
+    for (int i = 0; i < m_matrixSize; i++)
     {
-        delete[] m_pathMatrix;
-        m_pathMatrix = nullptr;
+        int toSrc = decode(dist[i * stride + srcIndex]);
+
+        if (toSrc < 999999 && toSrc + distance <= decode(dist[i * stride + destIndex]) + slack)
+            m_matrixDirtyRows[i] = 1;
     }
+}
 
-    m_distMatrix = new int[g_numWaypoints * g_numWaypoints];
-    m_pathMatrix = new int[g_numWaypoints * g_numWaypoints];
+void Waypoint::RemoveWaypointFromMatrix(int index)
+{
+    // must be called before the waypoint is deleted. drops its row and column and renumbers the rest
+    // the same way Delete does, rows that went through it are searched again by UpdatePathMatrix.
 
-    if (m_distMatrix == nullptr || m_pathMatrix == nullptr)
+    if (!PrepareMatrixEdit() || index >= m_matrixSize)
         return;
 
-    if (LoadPathMatrix())
-        return; // matrix loaded from file
+    int i, j;
 
     for (i = 0; i < g_numWaypoints; i++)
     {
-        for (j = 0; j < g_numWaypoints; j++)
+        for (j = 0; j < Const_MaxPathIndex; j++)
         {
-            if (i == j)
-            {
-                m_distMatrix[(i * g_numWaypoints) + i] = 0;
-                continue;
-            }
-            m_distMatrix[i * g_numWaypoints + j] = 999999;
-            m_pathMatrix[i * g_numWaypoints + j] = -1;
+            if (m_paths[i]->index[j] == index)
+                RemovePathFromMatrix(i, index, m_paths[i]->distances[j]);
         }
     }
 
-    for (i = 0; i < g_numWaypoints; i++)
+    const int stride = m_matrixStride;
+    uint16* path = &m_matrixBuffer[0];
+    uint16* dist = &m_matrixBuffer[stride * stride];
+
+    // moving cells down and left never overwrites one that wasn't moved yet
+    for (i = 0; i < m_matrixSize; i++)
     {
-        for (j = 0; j < Const_MaxPathIndex; j++)
+        if (i == index)
+            continue;
+
+        int row = i > index ? i - 1 : i;
+
+        for (j = 0; j < m_matrixSize; j++)
         {
-            if (m_paths[i]->index[j] >= 0 && m_paths[i]->index[j] < g_numWaypoints)
-            {
-                m_distMatrix[(i * g_numWaypoints) + m_paths[i]->index[j]] = m_paths[i]->distances[j];
-                m_pathMatrix[(i * g_numWaypoints) + m_paths[i]->index[j]] = m_paths[i]->index[j];
-            }
+            if (j == index)
+                continue;
+
+            int column = j > index ? j - 1 : j;
+            uint16 next = path[i * stride + j];
+
+            if (next == index)
+                next = 0xffff; // row is dirty
+            else if (next != 0xffff && next > index)
+                next--;
+
+            path[row * stride + column] = next;
+            dist[row * stride + column] = dist[i * stride + j];
         }
+
+        m_matrixDirtyRows[row] = m_matrixDirtyRows[i];
     }
 
-    for (k = 0; k < g_numWaypoints; k++)
+    m_matrixSize--;
+
+    for (i = 0; i <= m_matrixSize; i++)
     {
-        for (i = 0; i < g_numWaypoints; i++)
-        {
-            int ik = (i * g_numWaypoints) + k;
-            for (j = 0; j < g_numWaypoints; j++)
-            {
-                int kj = (k * g_numWaypoints) + j;
-                int ij = (i * g_numWaypoints) + j;
-                if (m_distMatrix[ik] + m_distMatrix[kj] < m_distMatrix[ij])
-                {
-                    m_distMatrix[ij] = m_distMatrix[ik] + m_distMatrix[kj];
-                    m_pathMatrix[ij] = m_pathMatrix[ik];
-                }
-            }
-        }
+        path[m_matrixSize * stride + i] = path[i * stride + m_matrixSize] = 0xffff;
+        dist[m_matrixSize * stride + i] = dist[i * stride + m_matrixSize] = 0xffff;
     }
 
-    // save path matrix to file for faster access
-    SavePathMatrix();
+    m_matrixDirtyRows[m_matrixSize] = 0;
 }
 
-void Waypoint::SavePathMatrix(void)
+void Waypoint::UpdatePathMatrix(void)
 {
-    File fp(FormatBuffer("%sdata/%s.pmt", GetWaypointDir(), GetMapName()), "wb");
+    // searches every dirty row again on the current waypoints
 
-    // unable to open file
-    if (!fp.IsValid())
-    {
-        AddLogEntry(LOG_FATAL, "Failed to open file for writing, waypoint/data folder isn't exits?");
+    if (!m_matrixEditing || m_matrixSize != g_numWaypoints)
         return;
-    }
 
-    // write number of waypoints
-    fp.Write(&g_numWaypoints, sizeof(int));
+    const int stride = m_matrixStride;
+    uint16* path = &m_matrixBuffer[0];
+    uint16* dist = &m_matrixBuffer[stride * stride];
 
-    // write path & distance matrix
-    fp.Write(m_pathMatrix, sizeof(int), g_numWaypoints * g_numWaypoints);
-    fp.Write(m_distMatrix, sizeof(int), g_numWaypoints * g_numWaypoints);
+    vector <int> rowDist;
+    vector <int> firstHop;
+    vector <int> heap; // binary heap of (distance, waypoint) pairs, stale entries are skipped
 
-    // and close the file
-    fp.Close();
-}
+    auto push = [&heap](int distance, int index)
+    {
+        heap.push_back(distance);
+        heap.push_back(index);
 
-bool Waypoint::LoadPathMatrix(void)
-{
-    File fp(FormatBuffer("%sdata/%s.pmt", GetWaypointDir(), GetMapName()), "rb");
+        for (int child = static_cast <int> (heap.size() / 2) - 1; child > 0;)
+        {
+            int parent = (child - 1) / 2;
+            if (heap[parent * 2] <= heap[child * 2])
+                break;
 
-    // file doesn't exists return false
-    if (!fp.IsValid())
-        return false;
+            int tempDist = heap[parent * 2], tempIndex = heap[parent * 2 + 1];
+            heap[parent * 2] = heap[child * 2];
+            heap[parent * 2 + 1] = heap[child * 2 + 1];
+            heap[child * 2] = tempDist;
+            heap[child * 2 + 1] = tempIndex;
+            child = parent;
+        }
+    };
+
+    auto pop = [&heap](int& distance, int& index)
+    {
+        distance = heap[0];
+        index = heap[1];
+
+        int size = static_cast <int> (heap.size() / 2) - 1;
+        heap[0] = heap[size * 2];
+        heap[1] = heap[size * 2 + 1];
+        heap.resize(size * 2);
+
+        for (int parent = 0;;)
+        {
+            int child = parent * 2 + 1;
+            if (child >= size)
+                break;
+
+            if (child + 1 < size && heap[(child + 1) * 2] < heap[child * 2])
+                child++;
 
-    int num = 0;
+            if (heap[parent * 2] <= heap[child * 2])
+                break;
 
-    // read number of waypoints
-    fp.Read(&num, sizeof(int));
+            int tempDist = heap[parent * 2], tempIndex = heap[parent * 2 + 1];
+            heap[parent * 2] = heap[child * 2];
+            heap[parent * 2 + 1] = heap[child * 2 + 1];
+            heap[child * 2] = tempDist;
+            heap[child * 2 + 1] = tempIndex;
+            parent = child;
+        }
+    };
 
-    if (num != g_numWaypoints)
+    for (int source = 0; source < m_matrixSize; source++)
     {
-        AddLogEntry(LOG_DEFAULT, "Wrong number of points (pmt:%d/cur:%d). Matrix will be rebuilded/n",
-            "********* If you use new waypoint, you need get the new .pmt file"
-            , num, g_numWaypoints);
-        fp.Close();
-		
-        unlink(FormatBuffer("%sdata/%s.pmt", GetWaypointDir(), GetMapName()));
+        if (!m_matrixDirtyRows[source])
+            continue;
 
-        return false;
-    }
+        m_matrixDirtyRows[source] = 0;
 
-    // read path & distance matrixes
-    fp.Read(m_pathMatrix, sizeof(int), g_numWaypoints * g_numWaypoints);
-    fp.Read(m_distMatrix, sizeof(int), g_numWaypoints * g_numWaypoints);
+        rowDist.assign(m_matrixSize, 999999);
+        firstHop.assign(m_matrixSize, -1);
+        heap.clear();
 
-    // and close the file
-    fp.Close();
+        rowDist[source] = 0;
+        push(0, source);
 
-    return true;
-}
+        while (!heap.empty())
+        {
+            int distance, current;
+            pop(distance, current);
 
-int Waypoint::GetPathDistance(int srcIndex, int destIndex)
-{
-    if (!IsValidWaypoint(srcIndex) || !IsValidWaypoint(destIndex))
-        return 9999;
+            if (distance > rowDist[current])
+                continue;
+
+            Path* node = m_paths[current];
+            for (int j = 0; j < Const_MaxPathIndex; j++)
+            {
+                int next = node->index[j];
+                if (next < 0 || next >= m_matrixSize)
+                    continue;
+
+                int candidate = distance + node->distances[j];
+                if (candidate < rowDist[next])
+                {
+                    rowDist[next] = candidate;
+                    firstHop[next] = current == source ? next : firstHop[current];
+                    push(candidate, next);
+                }
+            }
+        }
+
+        int maxDist = 0;
+        for (int j = 0; j < m_matrixSize; j++)
+        {
+            if (rowDist[j] < 999999 && rowDist[j] > maxDist)
+                maxDist = rowDist[j];
+        }
+
+        FitDistanceShift(maxDist);
+
+        for (int j = 0; j < m_matrixSize; j++)
+        {
+            int value = rowDist[j] >> m_distShift;
 
-    return *(m_distMatrix + (srcIndex * g_numWaypoints) + destIndex);
+            path[source * stride + j] = firstHop[j] < 0 ? 0xffff : static_cast <uint16> (firstHop[j]);
+            dist[source * stride + j] = rowDist[j] >= 999999 ? 0xffff : static_cast <uint16> (value < 0xfffe ? value : 0xfffe);
+        }
+    }
 }
 
 float Waypoint::GetPathDistanceFloat(int srcIndex, int destIndex)
@@ -3068,6 +4939,91 @@ Path* Waypoint::GetPath(int id)
     return m_paths[id];
 }
 
+const int Const_PathBlockSize = 256;
+
+Path* Waypoint::AllocPath(void)
+{
+    if (m_freePaths.empty())
+    {
+        int first = static_cast <int> (m_pathBlocks.size()) * Const_PathBlockSize;
+        if (first >= Const_MaxWaypoints)
+            return nullptr;
+
+        PathSlot* block = new PathSlot[Const_PathBlockSize];
+
+        for (int i = 0; i < Const_PathBlockSize; i++)
+            block[i].slot = first + i;
+
+        m_pathBlocks.push_back(block);
+
+        // slots are taken from the back, so waypoints loaded in order get neighbouring slots
+        for (int i = first + Const_PathBlockSize - 1; i >= first; i--)
+            m_freePaths.push_back(i);
+    }
+
+    int slot = m_freePaths.back();
+    m_freePaths.pop_back();
+
+    Path* path = &m_pathBlocks[slot / Const_PathBlockSize][slot % Const_PathBlockSize].path;
+    memset(path, 0, sizeof(Path));
+    return path;
+}
+
+void Waypoint::FreePath(Path* path)
+{
+    if (path == nullptr)
+        return;
+
+    // path is the first member of its slot
+    m_freePaths.push_back(reinterpret_cast <PathSlot*> (path)->slot);
+}
+
+// this function puts all slots back in order, every path must be freed already
+void Waypoint::ResetPaths(void)
+{
+    m_freePaths.clear();
+
+    // lowest slot on top, so the next load fills the arena from the start again
+    for (int i = static_cast <int> (m_pathBlocks.size()) * Const_PathBlockSize - 1; i >= 0; i--)
+        m_freePaths.push_back(i);
+}
+
+// this function makes room for count waypoints in all waypoint indexed arrays
+void Waypoint::ReserveWaypoints(int count)
+{
+    if (count <= static_cast <int> (m_paths.size()))
+        return;
+
+    m_paths.resize(count, nullptr);
+    m_waypointDisplayTime.resize(count, 0.0f);
+    m_goalsScore.resize(count, 0.0f);
+}
+
+// this function packs the connections of all waypoints, so the path search doesn't skip empty slots
+void Waypoint::UpdateLinks(void)
+{
+    if (!m_linksDirty && m_linksNum == g_numWaypoints)
+        return;
+
+    m_linkFirst.resize(g_numWaypoints + 1);
+    m_linkIndex.clear();
+
+    for (int i = 0; i < g_numWaypoints; i++)
+    {
+        m_linkFirst[i] = static_cast <int> (m_linkIndex.size());
+
+        for (int j = 0; j < Const_MaxPathIndex; j++)
+        {
+            if (IsValidWaypoint(m_paths[i]->index[j]))
+                m_linkIndex.push_back(m_paths[i]->index[j]);
+        }
+    }
+
+    m_linkFirst[g_numWaypoints] = static_cast <int> (m_linkIndex.size());
+    m_linksNum = g_numWaypoints;
+    m_linksDirty = false;
+}
+
 // this function removes waypoint file from the hard disk
 void Waypoint::EraseFromHardDisk(void)
 {
@@ -3165,7 +5121,7 @@ int Waypoint::AddGoalScore(int index, int other[4])
 void Waypoint::ClearGoalScore(void)
 {
     // iterate though all waypoints
-    for (int i = 0; i < Const_MaxWaypoints; i++)
+    for (size_t i = 0; i < m_goalsScore.size(); i++)
         m_goalsScore[i] = 0.0f;
 }
 
@@ -3183,12 +5139,28 @@ Waypoint::Waypoint(void)
     m_cacheWaypointIndex = -1;
     m_findWPIndex = -1;
     m_visibilityIndex = 0;
+    m_visibilityColumn = 0;
+    m_visibilityWords = 0;
+    m_visibilityNum = 0;
 
     m_lastDeclineWaypoint = -1;
 
     m_lastWaypoint = nullvec;
     m_isOnLadder = false;
 
+    m_numComponents = 0;
+    m_numKeys = 0;
+    m_keyWords = 0;
+    m_componentsDirty = true;
+
+    m_linksNum = 0;
+    m_linksDirty = true;
+
+    m_gridWidth = 0;
+    m_gridHeight = 0;
+    m_gridNumWaypoints = 0;
+    m_gridDirty = true;
+
     m_pathDisplayTime = 0.0f;
     m_arrowDisplayTime = 0.0f;
 
@@ -3202,27 +5174,29 @@ Waypoint::Waypoint(void)
 
     m_distMatrix = nullptr;
     m_pathMatrix = nullptr;
-    memset(m_paths, 0, sizeof(m_paths));
+    m_distShift = 0;
+    m_matrixSize = 0;
+    m_matrixStride = 0;
+    m_matrixEditing = false;
 }
 
 void Waypoint::Destroy()
 {
-    if (m_distMatrix != nullptr)
-        delete[] m_distMatrix;
-
-    if (m_pathMatrix != nullptr)
-        delete[] m_pathMatrix;
+    m_matrixFile.Close();
+    m_matrixBuffer.clear();
 
     m_distMatrix = nullptr;
     m_pathMatrix = nullptr;
+    m_matrixSize = 0;
+    m_matrixStride = 0;
+    m_matrixEditing = false;
 
     if (m_waypointPaths)
     {
         for (int i = 0; i < g_numWaypoints; i++)
-        {
-            delete m_paths[i];
             m_paths[i] = nullptr;
-        }
+
+        ResetPaths();
         m_waypointPaths = false;
     }
 }
@@ -3230,4 +5204,10 @@ void Waypoint::Destroy()
 Waypoint::~Waypoint(void)
 {
     Destroy();
+
+    for (auto block : m_pathBlocks)
+        delete[] block;
+
+    m_pathBlocks.clear();
+    m_freePaths.clear();
 }
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2003-2009, by Yet Another POD-Bot Development Team.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// $Id$
+//
+
+
+#include <core.h>
+
+WorldState::WorldState(void)
+{
+    maxClients = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        playerEnt[i] = nullptr;
+        playerFlags[i] = 0;
+    }
+
+    for (int i = 0; i < entityNum; i++)
+    {
+        entityEnt[i] = nullptr;
+        entityFlags[i] = 0;
+    }
+}
+
+void WorldState::Update(void)
+{
+    extern ConVar ebot_ping;
+
+    // real ping is only needed while someone is looking at scoreboard
+    bool needPing = ebot_ping.GetBool() && g_fakePingUpdate >= Engine::GetReference()->GetTime();
+
+    maxClients = Engine::GetReference()->GetMaxClients();
+
+    for (int i = 0; i < 32; i++)
+    {
+        playerEnt[i] = nullptr;
+        playerFlags[i] = 0;
+        playerTeam[i] = TEAM_COUNT;
+        playerWaypoint[i] = -1;
+        playerPing[i] = 0;
+
+        if (i >= maxClients)
+            continue;
+
+        edict_t* ent = INDEXENT(i + 1);
+        if (!IsValidPlayer(ent))
+            continue;
+
+        playerEnt[i] = ent;
+        playerFlags[i] = WORLD_USED;
+
+        if (IsAlive(ent))
+            playerFlags[i] |= WORLD_ALIVE;
+
+        if (IsZombieEntity(ent))
+            playerFlags[i] |= WORLD_ZOMBIE;
+
+        playerOrigin[i] = GetEntityOrigin(ent);
+        playerVelocity[i] = ent->v.velocity;
+        playerEyePosition[i] = ent->v.origin + ent->v.view_ofs;
+        playerTeam[i] = GetTeam(ent);
+        playerWaypoint[i] = g_clients[i].wpIndex;
+
+        if (needPing)
+        {
+            int loss;
+            PLAYER_CNX_STATS(ent, &playerPing[i], &loss);
+        }
+    }
+
+    for (int i = 0; i < entityNum; i++)
+    {
+        entityEnt[i] = nullptr;
+        entityFlags[i] = 0;
+
+        if (g_entityId[i] == -1)
+            continue;
+
+        edict_t* ent = INDEXENT(g_entityId[i]);
+        if (FNullEnt(ent))
+            continue;
+
+        entityEnt[i] = ent;
+        entityFlags[i] = WORLD_USED;
+
+        if (IsAlive(ent))
+            entityFlags[i] |= WORLD_ALIVE;
+
+        if (ent->v.effects & EF_NODRAW || ent->v.takedamage == DAMAGE_NO)
+            entityFlags[i] |= WORLD_HIDDEN;
+
+        entityOrigin[i] = GetEntityOrigin(ent);
+        entityTeam[i] = g_entityTeam[i];
+        entityAction[i] = g_entityAction[i];
+        entityWaypoint[i] = g_entityWpIndex[i];
+    }
+}
+
+WorldState g_world;
+
+Blackboard::Blackboard(void)
+{
+    soundNum = 0;
+    Reset();
+}
+
+void Blackboard::Update(void)
+{
+    occupants.assign(g_numWaypoints, 0);
+    soundNum = 0;
+
+    vector <int> nearby;
+
+    for (int i = 0; i < g_world.maxClients; i++)
+    {
+        if (!g_world.IsAlivePlayer(i))
+            continue;
+
+        uint32_t bit = 1u << i;
+
+        // waypoints near the player, grid search leaves out the ones exactly on the radius
+        g_waypoint->FindInGridRadius(g_world.playerOrigin[i], 65.0f, nearby);
+
+        for (int index : nearby)
+        {
+            if ((g_waypoint->GetPath(index)->origin - g_world.playerOrigin[i]).GetLengthSquared() <= 64.0f * 64.0f)
+                occupants[index] |= bit;
+        }
+
+        // bots also hold the waypoint they're heading to
+        Bot* bot = g_botManager->GetBot(i);
+
+        if (bot != nullptr && IsValidWaypoint(bot->m_currentWaypointIndex))
+            occupants[bot->m_currentWaypointIndex] |= bit;
+    }
+
+    for (const auto& client : g_clients)
+    {
+        if (!(client.flags & CFLAG_USED) || !(client.flags & CFLAG_ALIVE) || FNullEnt(client.ent))
+            continue;
+
+        // ducking players are silent, and too loud sounds are not sounds of players
+        if ((client.ent->v.flags & FL_DUCKING) || client.hearingDistance >= 2048.0f)
+            continue;
+
+        soundEnt[soundNum] = client.ent;
+        soundOrigin[soundNum] = client.soundPosition;
+        soundDistance[soundNum] = client.hearingDistance;
+        soundNum++;
+    }
+}
+
+void Blackboard::Reset(void)
+{
+    for (int team = 0; team < TEAM_COUNT; team++)
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            seenTime[team][i] = 0.0f;
+            seenOrigin[team][i] = nullvec;
+        }
+    }
+}
+
+void Blackboard::AddSighting(int team, edict_t* enemy)
+{
+    if (team < 0 || team >= TEAM_COUNT || !IsValidPlayer(enemy))
+        return;
+
+    int index = ENTINDEX(enemy) - 1;
+
+    if (index < 0 || index >= 32)
+        return;
+
+    seenTime[team][index] = Engine::GetReference()->GetTime();
+    seenOrigin[team][index] = GetEntityOrigin(enemy);
+}
+
+bool Blackboard::GetLastSighting(int team, float maxAge, Vector& origin) const
+{
+    if (team < 0 || team >= TEAM_COUNT)
+        return false;
+
+    float latest = Engine::GetReference()->GetTime() - maxAge;
+    bool found = false;
+
+    for (int i = 0; i < g_world.maxClients; i++)
+    {
+        if (!g_world.IsAlivePlayer(i) || seenTime[team][i] <= 0.0f || seenTime[team][i] < latest)
+            continue;
+
+        latest = seenTime[team][i];
+        origin = seenOrigin[team][i];
+        found = true;
+    }
+
+    return found;
+}
+
+Blackboard g_blackboard;